@@ -0,0 +1,494 @@
+#include "linked_list.h"
+#include "unrolled_list.h"
+#include "offset_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "common_defs.h"
+
+#define CHURN_OPS 1000000
+
+// Current time in nanoseconds
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Open a counter for this thread's cache misses (-1 if the kernel doesn't allow it)
+static int cache_misses_open(void)
+{
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+// Start counting from zero
+static void cache_misses_start(int fd)
+{
+    if (fd < 0)
+        return;
+    ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+    ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+}
+
+// Stop counting and return the count (-1 if there is no counter)
+static long long cache_misses_stop(int fd)
+{
+    long long count = -1;
+    if (fd < 0)
+        return -1;
+    ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (read(fd, &count, sizeof(count)) != sizeof(count))
+        return -1;
+    return count;
+}
+
+// Print a cache miss count per operation, or n/a without a counter
+static void print_misses(long long misses, double ops)
+{
+    if (misses < 0)
+        printf("   cache misses: n/a\n");
+    else
+        printf("   cache misses: %6.3f/op\n", misses / ops);
+}
+
+#define MANY_OPS 1000000
+
+// insert_after + search, round robin over 10 to 4000 live lists (ns per pair).
+// Every call has to find its list's node store first.
+static void churn_many_lists()
+{
+    static Node *heads[4000];
+
+    for (int lists = 10; lists <= 4000; lists = lists < 1000 ? lists * 10 : lists * 4)
+    {
+        int per_list = MANY_OPS / lists;
+        for (int l = 0; l < lists; l++)
+        {
+            heads[l] = NULL;
+            list_init(&heads[l], sizeof(Node) * (per_list + 1));
+            list_insert(&heads[l], 0);
+        }
+
+        int found = 0;
+        double start = now_ns();
+        for (int op = 0; op < per_list * lists; op++)
+        {
+            Node **head = &heads[op % lists];
+            list_insert_after(*head, (uint16_t)op);
+            found += list_search(head, 0) != NULL;
+        }
+        double elapsed = now_ns() - start;
+        printf("\t%8d lists: insert_after + search round robin %8.1f ns/op%s\n", lists,
+               elapsed / (per_list * lists), found == per_list * lists ? "" : " (?)");
+
+        for (int l = 0; l < lists; l++)
+            list_cleanup(&heads[l]);
+    }
+}
+
+// Insert/delete throughput on lists of growing length, then a full traversal
+// of the churned list, with cache misses for both phases where available
+void bench_list_churn()
+{
+    printf_yellow("  List insert/delete churn and traversal\n");
+    int fd = cache_misses_open();
+
+    for (int length = 1000; length <= 1000000; length *= 10)
+    {
+        Node *head = NULL;
+        list_init(&head, sizeof(Node) * (length + 1));
+
+        // Build the list; insert after the head so each insert is O(1)
+        list_insert(&head, 0);
+        for (int k = 1; k < length; k++)
+            list_insert_after(head, (uint16_t)k);
+
+        // Churn: drop the head and put a new node in behind the next one
+        srand(42);
+        cache_misses_start(fd);
+        double start = now_ns();
+        for (int op = 0; op < CHURN_OPS; op++)
+        {
+            list_delete(&head, head->data);
+            list_insert_after(head, (uint16_t)rand());
+        }
+        double elapsed = now_ns() - start;
+        long long misses = cache_misses_stop(fd);
+        printf("\t%8d nodes: churn %8.2f Mops/s", length, 2.0 * CHURN_OPS / elapsed * 1e3);
+        print_misses(misses, 2.0 * CHURN_OPS);
+
+        // Traverse the whole list
+        cache_misses_start(fd);
+        start = now_ns();
+        int count = list_count_nodes(&head);
+        elapsed = now_ns() - start;
+        misses = cache_misses_stop(fd);
+        printf("\t%8d nodes: walk  %8.2f ns/node", count, elapsed / count);
+        print_misses(misses, count);
+
+        list_cleanup(&head);
+    }
+    if (fd >= 0)
+        close(fd);
+    churn_many_lists();
+}
+
+#define SCAN_ELEMENTS 100000000.0
+
+// Traversal and search throughput of the linked list against the unrolled list,
+// with lists of 10^3 to 10^7 values. Searches look for a value that isn't there.
+void bench_unrolled()
+{
+    printf_yellow("  Linked list vs. unrolled list: traversal and search\n");
+
+    for (int length = 1000; length <= 10000000; length *= 10)
+    {
+        List list;
+        UnrolledList ulist;
+        list_create(&list, sizeof(Node) * length);
+        ulist_init(&ulist, sizeof(UnrolledChunk) * (length / UNROLLED_CHUNK_VALUES + 1));
+        for (int k = 0; k < length; k++)
+        {
+            list_append(&list, (uint16_t)(k % 60000));
+            ulist_insert(&ulist, (uint16_t)(k % 60000));
+        }
+        int reps = SCAN_ELEMENTS / length;
+
+        // Traversal: add up every value
+        unsigned long sum = 0;
+        double start = now_ns();
+        for (int r = 0; r < reps; r++)
+            for (Node *node = list.head; node; node = node->next)
+                sum += node->data;
+        double list_walk = now_ns() - start;
+
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            for (UnrolledChunk *chunk = ulist.head; chunk; chunk = chunk->next)
+                for (int i = 0; i < chunk->count; i++)
+                    sum += chunk->values[i];
+        double ulist_walk = now_ns() - start;
+
+        // Search for a missing value, so the whole list is scanned
+        int found = 0;
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            found += list_search(&list.head, 65000) != NULL;
+        double list_find = now_ns() - start;
+
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            found += ulist_search(&ulist, 65000).chunk != NULL;
+        double ulist_find = now_ns() - start;
+
+        double values = (double)reps * length;
+        printf("\t%8d values: walk %7.1f vs %7.1f Mvalues/s, search %7.1f vs %7.1f Mvalues/s%s\n", length,
+               values / list_walk * 1e3, values / ulist_walk * 1e3,
+               values / list_find * 1e3, values / ulist_find * 1e3, sum && !found ? "" : " (?)");
+
+        list_destroy(&list);
+        ulist_cleanup(&ulist);
+    }
+}
+
+// Search throughput of list_search against the unrolled list's scalar, SSE2 and AVX2
+// compares, with lists of 10^3 to 10^7 values. Searches look for a value that isn't there.
+void bench_simd_search()
+{
+    printf_yellow("  list_search vs. unrolled list search by mode (Mvalues/s)\n");
+    const char *names[] = {"scalar", "sse2", "avx2"};
+    UnrolledSearchMode modes[] = {ULIST_SEARCH_SCALAR, ULIST_SEARCH_SSE2, ULIST_SEARCH_AVX2};
+
+    for (int length = 1000; length <= 10000000; length *= 10)
+    {
+        List list;
+        UnrolledList ulist;
+        list_create(&list, sizeof(Node) * length);
+        ulist_init(&ulist, sizeof(UnrolledChunk) * (length / UNROLLED_CHUNK_VALUES + 1));
+        for (int k = 0; k < length; k++)
+        {
+            list_append(&list, (uint16_t)(k % 60000));
+            ulist_insert(&ulist, (uint16_t)(k % 60000));
+        }
+        int reps = SCAN_ELEMENTS / length;
+        double values = (double)reps * length;
+        int found = 0;
+
+        double start = now_ns();
+        for (int r = 0; r < reps; r++)
+            found += list_search(&list.head, 65000) != NULL;
+        printf("\t%8d values: list_search %7.1f", length, values / (now_ns() - start) * 1e3);
+
+        for (int m = 0; m < 3; m++)
+        {
+            if (!ulist_set_search_mode(modes[m]))
+            {
+                printf(", %s n/a", names[m]);
+                continue;
+            }
+            start = now_ns();
+            for (int r = 0; r < reps; r++)
+                found += ulist_search(&ulist, 65000).chunk != NULL;
+            printf(", %s %7.1f", names[m], values / (now_ns() - start) * 1e3);
+        }
+        printf("%s\n", found ? " (?)" : "");
+
+        ulist_set_search_mode(ULIST_SEARCH_AUTO);
+        list_destroy(&list);
+        ulist_cleanup(&ulist);
+    }
+}
+
+// Time searches and deletes by value on a list (ns per operation). The values
+// follow an odd stride through all 65536 values, so no value is deleted twice.
+static void time_value_ops(List *list, int ops, double *search_ns, double *delete_ns)
+{
+    int found = 0;
+
+    double start = now_ns();
+    for (int op = 0; op < ops; op++)
+        found += list_search(&list->head, (uint16_t)(op * 40503)) != NULL;
+    *search_ns = (now_ns() - start) / ops;
+
+    start = now_ns();
+    for (int op = 0; op < ops; op++)
+        list_remove(list, (uint16_t)(op * 40503));
+    *delete_ns = (now_ns() - start) / ops;
+}
+
+// The list_search/list_delete loops of the tests scaled up to millions of nodes,
+// plain list against indexed list, with the memory the index takes
+void bench_indexed()
+{
+    printf_yellow("  Plain vs. indexed list: search and delete by value (ns/op)\n");
+
+    for (int length = 100000; length <= 10000000; length *= 10)
+    {
+        double search_ns[2], delete_ns[2], build_ns[2];
+        size_t index_size = 0;
+
+        for (int indexed = 0; indexed <= 1; indexed++)
+        {
+            List list;
+            if (indexed)
+                list_create_indexed(&list, sizeof(Node) * length);
+            else
+                list_create(&list, sizeof(Node) * length);
+
+            double start = now_ns();
+            for (int k = 0; k < length; k++)
+                list_append(&list, (uint16_t)k);
+            build_ns[indexed] = (now_ns() - start) / length;
+            index_size = list_index_size(&list);
+
+            // A plain list needs a scan per operation, so it gets fewer of them
+            time_value_ops(&list, indexed ? 50000 : 1000, &search_ns[indexed], &delete_ns[indexed]);
+            list_destroy(&list);
+        }
+
+        printf("\t%8d nodes: append %5.1f vs %5.1f, search %8.1f vs %5.1f, delete %8.1f vs %5.1f,"
+               " index %6.1f MiB (%.1f bytes/node)\n",
+               length, build_ns[0], build_ns[1], search_ns[0], search_ns[1], delete_ns[0], delete_ns[1],
+               index_size / 1048576.0, (double)index_size / length);
+    }
+}
+
+// The per-node fprintf loop list_display used to run, for comparison
+static void display_printf(Node *head, FILE *out)
+{
+    fprintf(out, "[");
+    for (Node *current = head; current; current = current->next)
+    {
+        fprintf(out, current == head ? "%u" : ", %u", current->data);
+    }
+    fprintf(out, "]");
+}
+
+// Text output of a 10^6 node list: fprintf per node vs. list_write to a FILE*,
+// list_write_fd and list_format into a buffer (Mvalues/s). Output goes to /dev/null.
+void bench_format()
+{
+    printf_yellow("  List text output: fprintf per node vs. list_write / list_write_fd / list_format\n");
+    const int length = 1000000;
+    const int reps = 20;
+    FILE *out = fopen("/dev/null", "w");
+    if (!out)
+    {
+        printf("\tcannot open /dev/null\n");
+        return;
+    }
+
+    List list;
+    list_create(&list, sizeof(Node) * length);
+    for (int k = 0; k < length; k++)
+        list_append(&list, (uint16_t)rand());
+    size_t cap = list_format(&list.head, NULL, 0) + 1;
+    char *buf = malloc(cap);
+
+    double start = now_ns();
+    for (int r = 0; r < reps; r++)
+        display_printf(list.head, out);
+    fflush(out);
+    double printf_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < reps; r++)
+        list_write(&list.head, out);
+    fflush(out);
+    double write_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < reps; r++)
+        list_write_fd(&list.head, fileno(out));
+    double fd_ns = now_ns() - start;
+
+    start = now_ns();
+    for (int r = 0; r < reps; r++)
+        list_format(&list.head, buf, cap);
+    double format_ns = now_ns() - start;
+
+    double values = (double)reps * length;
+    printf("\t%8d nodes: fprintf %6.1f, list_write %6.1f, list_write_fd %6.1f, list_format %6.1f\n", length,
+           values / printf_ns * 1e3, values / write_ns * 1e3, values / fd_ns * 1e3, values / format_ns * 1e3);
+
+    free(buf);
+    list_destroy(&list);
+    fclose(out);
+}
+
+// Rebuilding a 10^7 node list: list_append per value vs. list_save to a file and
+// list_create_from_file back from it (ms). The file goes to /tmp and is removed afterwards.
+void bench_snapshot()
+{
+    printf_yellow("  Rebuilding a list: list_append vs. list_save / list_create_from_file\n");
+    const char *path = "/tmp/bench_linked_list.snapshot";
+
+    for (int length = 100000; length <= 10000000; length *= 10)
+    {
+        List list;
+        List copy;
+        double start = now_ns();
+        list_create(&list, sizeof(Node) * length);
+        for (int k = 0; k < length; k++)
+            list_append(&list, (uint16_t)k);
+        double append_ns = now_ns() - start;
+
+        start = now_ns();
+        int failed = list_save(&list.head, path);
+        double save_ns = now_ns() - start;
+
+        start = now_ns();
+        failed |= list_create_from_file(&copy, path, sizeof(Node) * length);
+        double load_ns = now_ns() - start;
+
+        printf("\t%8d nodes: append %8.2f, save %8.2f, load %8.2f ms%s\n", length, append_ns / 1e6,
+               save_ns / 1e6, load_ns / 1e6, failed || list_count(&copy) != (size_t)length ? " (?)" : "");
+        list_destroy(&copy);
+        list_destroy(&list);
+    }
+    unlink(path);
+}
+
+// Pointer-linked list vs. offset list: traversal and search throughput and bytes
+// per node, with lists of 10^3 to 10^7 values. Searches look for a value that isn't there.
+void bench_offset()
+{
+    printf_yellow("  Linked list vs. offset list: traversal and search (Mvalues/s)\n");
+    mem_pool_t *pool = mem_pool_create(olist_size(10000000) + 4096);
+
+    for (int length = 1000; length <= 10000000; length *= 10)
+    {
+        List list;
+        list_create(&list, sizeof(Node) * length);
+        OffsetList *olist = olist_create(pool, olist_size(length));
+        for (int k = 0; k < length; k++)
+        {
+            list_append(&list, (uint16_t)(k % 60000));
+            olist_insert(olist, (uint16_t)(k % 60000));
+        }
+        int reps = SCAN_ELEMENTS / length;
+
+        unsigned long sum = 0;
+        double start = now_ns();
+        for (int r = 0; r < reps; r++)
+            for (Node *node = list.head; node; node = node->next)
+                sum += node->data;
+        double list_walk = now_ns() - start;
+
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            for (OffsetNode *node = olist_head(olist); node; node = olist_next(olist, node))
+                sum += node->data;
+        double olist_walk = now_ns() - start;
+
+        int found = 0;
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            found += list_search(&list.head, 65000) != NULL;
+        double list_find = now_ns() - start;
+
+        start = now_ns();
+        for (int r = 0; r < reps; r++)
+            found += olist_search(olist, 65000) != NULL;
+        double olist_find = now_ns() - start;
+
+        double values = (double)reps * length;
+        printf("\t%8d values: walk %7.1f vs %7.1f, search %7.1f vs %7.1f, %zu vs %zu bytes/node%s\n", length,
+               values / list_walk * 1e3, values / olist_walk * 1e3, values / list_find * 1e3,
+               values / olist_find * 1e3, sizeof(Node), sizeof(OffsetNode), sum && !found ? "" : " (?)");
+
+        olist_destroy(pool, olist);
+        list_destroy(&list);
+    }
+    mem_pool_destroy(pool);
+}
+
+int main(int argc, char *argv[])
+{
+    int which = argc > 1 ? atoi(argv[1]) : 0;
+
+    if (which < 0)
+    {
+        printf("Usage: %s [benchmark]\n", argv[0]);
+        printf(" 1. bench_list_churn - insert/delete throughput and traversal as the list grows\n");
+        printf(" 2. bench_unrolled - traversal and search, linked list vs. unrolled list\n");
+        printf(" 3. bench_simd_search - list_search vs. scalar/SSE2/AVX2 unrolled list search\n");
+        printf(" 4. bench_indexed - search and delete by value, plain vs. indexed list\n");
+        printf(" 5. bench_format - text output, fprintf per node vs. list_write and list_format\n");
+        printf(" 6. bench_snapshot - rebuilding a list, list_append vs. save and load\n");
+        printf(" 7. bench_offset - traversal and search, pointer links vs. 32-bit offset links\n");
+        printf(" 0. Run all benchmarks\n");
+        return 1;
+    }
+
+    if (which == 0 || which == 1)
+        bench_list_churn();
+    if (which == 0 || which == 2)
+        bench_unrolled();
+    if (which == 0 || which == 3)
+        bench_simd_search();
+    if (which == 0 || which == 4)
+        bench_indexed();
+    if (which == 0 || which == 5)
+        bench_format();
+    if (which == 0 || which == 6)
+        bench_snapshot();
+    if (which == 0 || which == 7)
+        bench_offset();
+
+    return 0;
+}
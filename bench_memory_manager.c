@@ -0,0 +1,538 @@
+#include "memory_manager.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "common_defs.h"
+
+// Current time in nanoseconds
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// Time mem_alloc with a growing number of live blocks in the pool.
+// Every other block is freed first, so the pool is full of small holes
+// that the timed (larger) requests can not use.
+void bench_alloc_latency()
+{
+    printf_yellow("  mem_alloc latency vs. live blocks\n");
+    const int timed = 10000;
+    void **extra = malloc(sizeof(void *) * timed);
+
+    for (int live = 1000; live <= 1000000; live *= 10)
+    {
+        mem_init((size_t)live * 64 + (size_t)timed * 256);
+        void **blocks = malloc(sizeof(void *) * live);
+
+        srand(42);
+        for (int k = 0; k < live; k++)
+        {
+            blocks[k] = mem_alloc(16 + rand() % 48);
+        }
+        for (int k = 0; k < live; k += 2)
+        {
+            mem_free(blocks[k]);
+        }
+
+        double start = now_ns();
+        for (int k = 0; k < timed; k++)
+        {
+            extra[k] = mem_alloc(128 + rand() % 128);
+        }
+        double elapsed = now_ns() - start;
+
+        printf("\t%8d live blocks: %8.1f ns/alloc\n", live, elapsed / timed);
+
+        mem_deinit();
+        free(blocks);
+    }
+    free(extra);
+}
+
+// Time mem_free with a growing number of live blocks in the pool.
+// Blocks are released in random order so neighbours get merged on both sides.
+void bench_free_latency()
+{
+    printf_yellow("  mem_free latency vs. live blocks\n");
+
+    for (int live = 1000; live <= 1000000; live *= 10)
+    {
+        mem_init((size_t)live * 64);
+        void **blocks = malloc(sizeof(void *) * live);
+
+        srand(42);
+        for (int k = 0; k < live; k++)
+        {
+            blocks[k] = mem_alloc(16 + rand() % 48);
+        }
+        for (int k = live - 1; k > 0; k--)
+        {
+            int j = rand() % (k + 1);
+            void *tmp = blocks[k];
+            blocks[k] = blocks[j];
+            blocks[j] = tmp;
+        }
+
+        double start = now_ns();
+        for (int k = 0; k < live; k++)
+        {
+            mem_free(blocks[k]);
+        }
+        double elapsed = now_ns() - start;
+
+        printf("\t%8d live blocks: %8.1f ns/free\n", live, elapsed / live);
+
+        mem_deinit();
+        free(blocks);
+    }
+}
+
+#define THREAD_OPS 1000000
+
+// Worker for bench_threads: small-block alloc/free churn on a private working set
+static void *churn_worker(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    void *blocks[64] = {0};
+
+    for (int op = 0; op < THREAD_OPS; op++)
+    {
+        int k = rand_r(&seed) % 64;
+        if (blocks[k])
+        {
+            mem_free(blocks[k]);
+            blocks[k] = NULL;
+        }
+        else
+        {
+            blocks[k] = mem_alloc(8 + rand_r(&seed) % 56);
+        }
+    }
+    for (int k = 0; k < 64; k++)
+        mem_free(blocks[k]);
+    return NULL;
+}
+
+// Total small-block throughput with 1 to 8 threads sharing the pool
+void bench_threads()
+{
+    printf_yellow("  Small-block throughput vs. threads\n");
+
+    for (int nThreads = 1; nThreads <= 8; nThreads *= 2)
+    {
+        pthread_t threads[8];
+        mem_init(64 * 1024 * 1024);
+
+        double start = now_ns();
+        for (int t = 0; t < nThreads; t++)
+            pthread_create(&threads[t], NULL, churn_worker, (void *)(size_t)(t + 1));
+        for (int t = 0; t < nThreads; t++)
+            pthread_join(threads[t], NULL);
+        double elapsed = now_ns() - start;
+
+        printf("\t%d thread(s): %8.2f Mops/s\n", nThreads, (double)nThreads * THREAD_OPS / elapsed * 1e3);
+        mem_deinit();
+    }
+}
+
+// Small-block throughput with 1 to 8 forked processes sharing one pool, each
+// running the same churn as a bench_threads worker
+void bench_processes()
+{
+    printf_yellow("  Small-block throughput vs. processes on a shared pool\n");
+
+    for (int nProcs = 1; nProcs <= 8; nProcs *= 2)
+    {
+        mem_pool_t *pool = mem_pool_create_shared(64 * 1024 * 1024, 64 * 1024);
+        if (!pool)
+        {
+            printf("\tcannot create a shared pool\n");
+            return;
+        }
+
+        double start = now_ns();
+        for (int p = 0; p < nProcs; p++)
+        {
+            if (fork() == 0)
+            {
+                unsigned seed = p + 1;
+                void *blocks[64] = {0};
+                for (int op = 0; op < THREAD_OPS; op++)
+                {
+                    int k = rand_r(&seed) % 64;
+                    if (blocks[k])
+                    {
+                        mem_pool_free(pool, blocks[k]);
+                        blocks[k] = NULL;
+                    }
+                    else
+                    {
+                        blocks[k] = mem_pool_alloc(pool, 8 + rand_r(&seed) % 56);
+                    }
+                }
+                _exit(0);
+            }
+        }
+        while (wait(NULL) > 0)
+            ;
+        double elapsed = now_ns() - start;
+
+        printf("\t%d process(es): %8.2f Mops/s\n", nProcs, (double)nProcs * THREAD_OPS / elapsed * 1e3);
+        mem_pool_destroy(pool);
+    }
+}
+
+#define CHURN_LIVE 10000
+#define CHURN_OPS 10000000
+
+// A list node as used by linked_list.c: a uint16_t plus a pointer, 16 bytes
+typedef struct BenchNode {
+    uint16_t data;
+    struct BenchNode *next;
+} BenchNode;
+
+// Node-sized alloc/free churn from a slab compared with mem_alloc/mem_free
+void bench_node_churn()
+{
+    printf_yellow("  Node churn: mem_slab vs. mem_alloc\n");
+    BenchNode **nodes = calloc(CHURN_LIVE, sizeof(BenchNode *));
+
+    for (int use_slab = 0; use_slab <= 1; use_slab++)
+    {
+        mem_init((size_t)CHURN_LIVE * 64);
+        mem_slab_t *slab = use_slab ? mem_slab_create(sizeof(BenchNode), CHURN_LIVE) : NULL;
+        unsigned seed = 42;
+
+        double start = now_ns();
+        for (int op = 0; op < CHURN_OPS; op++)
+        {
+            int k = rand_r(&seed) % CHURN_LIVE;
+            if (nodes[k])
+            {
+                if (use_slab)
+                    mem_slab_free(slab, nodes[k]);
+                else
+                    mem_free(nodes[k]);
+                nodes[k] = NULL;
+            }
+            else
+            {
+                nodes[k] = use_slab ? mem_slab_alloc(slab) : mem_alloc(sizeof(BenchNode));
+                nodes[k]->data = (uint16_t)op;
+            }
+        }
+        double elapsed = now_ns() - start;
+
+        printf("\t%-9s: %8.1f ns/op\n", use_slab ? "mem_slab" : "mem_alloc", elapsed / CHURN_OPS);
+        memset(nodes, 0, sizeof(BenchNode *) * CHURN_LIVE);
+        mem_deinit();
+    }
+    free(nodes);
+}
+
+// Resident set size of this process in MiB
+static double rss_mib(void)
+{
+    long pages = 0;
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm)
+    {
+        if (fscanf(statm, "%*s %ld", &pages) != 1)
+            pages = 0;
+        fclose(statm);
+    }
+    return pages * (double)sysconf(_SC_PAGESIZE) / 1048576.0;
+}
+
+// Startup time and RSS of a malloc'd pool against mmap-backed pools: create the
+// pool, fill a quarter of it with one block, then free that block again
+void bench_startup()
+{
+    printf_yellow("  Pool startup and RSS: malloc vs. mmap (lazy), mmap + huge pages, mmap + release\n");
+    const char *names[] = {"malloc", "mmap", "mmap+huge", "mmap+release"};
+
+    for (size_t size = (size_t)256 << 20; size <= (size_t)1 << 30; size *= 2)
+    {
+        for (int kind = 0; kind < 4; kind++)
+        {
+            double base = rss_mib();
+            double start = now_ns();
+            mem_pool_t *pool = kind == 0   ? mem_pool_create(size)
+                               : kind == 1 ? mem_pool_create_mapped(size, 0)
+                               : kind == 2 ? mem_pool_create_mapped(size, MEM_MAP_HUGEPAGES)
+                                           : mem_pool_create_mapped(size, MEM_MAP_RELEASE);
+            double create_us = (now_ns() - start) / 1e3;
+            if (!pool)
+            {
+                printf("\t%5zu MiB %-12s: cannot create pool\n", size >> 20, names[kind]);
+                continue;
+            }
+            double rss_create = rss_mib() - base;
+
+            start = now_ns();
+            char *block = mem_pool_alloc(pool, size / 4);
+            memset(block, 1, size / 4);
+            double touch_ms = (now_ns() - start) / 1e6;
+            double rss_used = rss_mib() - base;
+
+            mem_pool_free(pool, block);
+            double rss_freed = rss_mib() - base;
+
+            printf("\t%5zu MiB %-12s: create %8.1f us, RSS %7.1f MiB, fill 1/4 %7.1f ms, RSS %7.1f MiB, after free %7.1f MiB\n",
+                   size >> 20, names[kind], create_us, rss_create, touch_ms, rss_used, rss_freed);
+            mem_pool_destroy(pool);
+        }
+    }
+}
+
+// Mixed alloc/free/resize load on each thread, for bench_latency
+static void *latency_worker(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    void *blocks[256] = {0};
+
+    for (int op = 0; op < THREAD_OPS; op++)
+    {
+        int k = rand_r(&seed) % 256;
+        if (!blocks[k])
+            blocks[k] = mem_alloc(8 + rand_r(&seed) % 1024);
+        else if (rand_r(&seed) % 4 == 0)
+            blocks[k] = mem_resize(blocks[k], 8 + rand_r(&seed) % 4096);
+        else
+        {
+            mem_free(blocks[k]);
+            blocks[k] = NULL;
+        }
+    }
+    for (int k = 0; k < 256; k++)
+        mem_free(blocks[k]);
+    return NULL;
+}
+
+// Latency percentiles of mem_alloc, mem_free and mem_resize under a mixed
+// load from several threads (needs a library built with make TRACE=1)
+void bench_latency()
+{
+    printf_yellow("  mem_alloc/mem_free/mem_resize latency percentiles\n");
+    const char *names[] = {"mem_alloc", "mem_free", "mem_resize"};
+    struct mem_latency lat;
+
+    if (!mem_latency(MEM_OP_ALLOC, &lat))
+    {
+        printf("\tnot available: rebuild with make TRACE=1\n");
+        return;
+    }
+    for (int nThreads = 1; nThreads <= 4; nThreads *= 4)
+    {
+        pthread_t threads[4];
+        mem_init(64 * 1024 * 1024);
+        mem_latency_reset();
+
+        for (int t = 0; t < nThreads; t++)
+            pthread_create(&threads[t], NULL, latency_worker, (void *)(size_t)(t + 1));
+        for (int t = 0; t < nThreads; t++)
+            pthread_join(threads[t], NULL);
+
+        for (int op = 0; op < MEM_OP_COUNT; op++)
+        {
+            mem_latency(op, &lat);
+            printf("\t%d thread(s) %-10s: %9zu ops, p50 %6zu ns, p99 %6zu ns, p99.9 %6zu ns, max %8zu ns\n",
+                   nThreads, names[op], lat.count, lat.p50_ns, lat.p99_ns, lat.p999_ns, lat.max_ns);
+        }
+        mem_deinit();
+    }
+}
+
+// malloc/realloc/free churn through the libc interface, for bench_preload
+static void *malloc_worker(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    void *blocks[256] = {0};
+
+    for (int op = 0; op < THREAD_OPS; op++)
+    {
+        int k = rand_r(&seed) % 256;
+        if (!blocks[k])
+            blocks[k] = malloc(8 + rand_r(&seed) % 1024);
+        else if (rand_r(&seed) % 4 == 0)
+            blocks[k] = realloc(blocks[k], 8 + rand_r(&seed) % 4096);
+        else
+        {
+            free(blocks[k]);
+            blocks[k] = NULL;
+        }
+    }
+    for (int k = 0; k < 256; k++)
+        free(blocks[k]);
+    return NULL;
+}
+
+// Throughput of malloc, realloc and free from 1 and 4 threads, with whatever
+// allocator the process runs on
+void bench_malloc()
+{
+    for (int nThreads = 1; nThreads <= 4; nThreads *= 4)
+    {
+        pthread_t threads[4];
+        double start = now_ns();
+        for (int t = 0; t < nThreads; t++)
+            pthread_create(&threads[t], NULL, malloc_worker, (void *)(size_t)(t + 1));
+        for (int t = 0; t < nThreads; t++)
+            pthread_join(threads[t], NULL);
+        double elapsed = now_ns() - start;
+
+        printf("\t%-14s %d thread(s): %8.2f Mops/s\n", getenv("LD_PRELOAD") ? "libmymalloc.so" : "glibc malloc",
+               nThreads, (double)nThreads * THREAD_OPS / elapsed * 1e3);
+    }
+}
+
+// Run bench_malloc in a new process on glibc malloc, then with LD_PRELOAD=./libmymalloc.so
+void bench_preload()
+{
+    printf_yellow("  malloc/realloc/free throughput: glibc vs. libmymalloc.so\n");
+    fflush(stdout);
+
+    for (int preload = 0; preload < 2; preload++)
+    {
+        pid_t pid = fork();
+        if (pid == 0)
+        {
+            if (preload)
+                setenv("LD_PRELOAD", "./libmymalloc.so", 1);
+            else
+                unsetenv("LD_PRELOAD");
+            execl("/proc/self/exe", "bench_memory_manager", "9", (char *)NULL);
+            _exit(127);
+        }
+        int status;
+        if (pid < 0 || waitpid(pid, &status, 0) != pid || !WIFEXITED(status) || WEXITSTATUS(status) != 0)
+            printf("\tbench_malloc failed%s\n", preload ? " (is libmymalloc.so built?)" : "");
+    }
+}
+
+// Grow two buffers side by side to 64 MiB, 1 MiB at a time, so neither can grow
+// in place: inside the pool every step copies, while large blocks with their own
+// mapping are grown by mremap
+void bench_large_resize()
+{
+    printf_yellow("  Growing two buffers to 64 MiB: in the pool vs. mmap'd large blocks\n");
+    const char *names[] = {"pool", "large blocks"};
+    const size_t step = (size_t)1 << 20, top = (size_t)64 << 20;
+
+    for (int large = 0; large < 2; large++)
+    {
+        mem_pool_t *pool = mem_pool_create_mapped(16 * top, 0);
+        if (large)
+            mem_pool_set_mmap_threshold(pool, step);
+
+        double start = now_ns();
+        char *buffers[2] = {NULL, NULL};
+        for (size_t size = step; size <= top; size += step)
+        {
+            for (int b = 0; b < 2; b++)
+            {
+                buffers[b] = mem_pool_resize(pool, buffers[b], size);
+                if (buffers[b])
+                    memset(buffers[b] + size - step, b, step);
+            }
+            if (!buffers[0] || !buffers[1])
+                break;
+        }
+        double elapsed = now_ns() - start;
+
+        struct mem_stats st;
+        mem_pool_stats(pool, &st);
+        printf("\t%-12s: %8.1f ms, %zu resizes moved, %zu in place\n", names[large], elapsed / 1e6, st.resizes_moved, st.resizes_in_place);
+        mem_pool_destroy(pool);
+    }
+}
+
+// Grow 1000 buffers by 64 bytes at a time, in random order, to 16 KiB each, as
+// string builders and vectors do; counts how the resizes got their room
+void bench_grow()
+{
+    printf_yellow("  Growing 1000 buffers by 64 bytes in random order to 16 KiB\n");
+    const int count = 1000, step = 64, top = 16 * 1024;
+    mem_pool_t *pool = mem_pool_create(64 << 20);
+    char *buffers[1000] = {NULL};
+    int sizes[1000] = {0};
+
+    srand(42);
+    double start = now_ns();
+    for (int done = 0; done < count;)
+    {
+        int b = rand() % count;
+        if (sizes[b] >= top)
+            continue;
+        sizes[b] += step;
+        buffers[b] = mem_pool_resize(pool, buffers[b], sizes[b]);
+        if (!buffers[b])
+            break;
+        buffers[b][sizes[b] - 1] = (char)b;
+        if (sizes[b] >= top)
+            done++;
+    }
+    double elapsed = now_ns() - start;
+
+    struct mem_stats st;
+    mem_pool_stats(pool, &st);
+    size_t resizes = (size_t)count * (top / step);
+    printf("	%8.1f ms (%.1f ns/resize), %zu in place, %zu shifted, %zu moved\n", elapsed / 1e6, elapsed / resizes,
+           st.resizes_in_place, st.resizes_shifted, st.resizes_moved);
+    mem_pool_destroy(pool);
+}
+
+int main(int argc, char *argv[])
+{
+    int which = argc > 1 ? atoi(argv[1]) : 0;
+
+    if (which < 0)
+    {
+        printf("Usage: %s [benchmark]\n", argv[0]);
+        printf(" 1. bench_alloc_latency - mem_alloc latency as live blocks grow\n");
+        printf(" 2. bench_free_latency - mem_free latency as live blocks grow\n");
+        printf(" 3. bench_threads - small-block throughput as threads are added\n");
+        printf(" 4. bench_node_churn - list node alloc/free from a slab vs. mem_alloc\n");
+        printf(" 5. bench_processes - small-block throughput as forked processes share a pool\n");
+        printf(" 6. bench_startup - pool startup time and RSS, malloc vs. mmap-backed pools\n");
+        printf(" 7. bench_latency - alloc/free/resize latency percentiles (make TRACE=1)\n");
+        printf(" 8. bench_preload - malloc throughput, glibc vs. LD_PRELOAD=./libmymalloc.so\n");
+        printf(" 9. bench_malloc - malloc throughput on the allocator in use (run by 8)\n");
+        printf(" 10. bench_large_resize - growing a buffer in the pool vs. as an mmap'd large block\n");
+        printf(" 11. bench_grow - growing many buffers a little at a time\n");
+        printf(" 0. Run all benchmarks\n");
+        return 1;
+    }
+
+    if (which == 0 || which == 1)
+        bench_alloc_latency();
+    if (which == 0 || which == 2)
+        bench_free_latency();
+    if (which == 0 || which == 3)
+        bench_threads();
+    if (which == 0 || which == 4)
+        bench_node_churn();
+    if (which == 0 || which == 5)
+        bench_processes();
+    if (which == 0 || which == 6)
+        bench_startup();
+    if (which == 0 || which == 7)
+        bench_latency();
+    if (which == 0 || which == 8)
+        bench_preload();
+    if (which == 9)
+        bench_malloc();
+    if (which == 0 || which == 10)
+        bench_large_resize();
+    if (which == 0 || which == 11)
+        bench_grow();
+
+    return 0;
+}
@@ -1,17 +1,425 @@
 #include "linked_list.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-// Initialize the list
+// Number of distinct node values; an indexed list has a chain of nodes for each
+#define VALUE_COUNT 65536
+
+// Slot number standing for "no node" in the index
+#define NO_NODE UINT32_MAX
+
+// Distance between neighbouring nodes in a list's slab, which keeps every object MEM_ALIGN aligned
+#define NODE_STRIDE ((sizeof(Node) + MEM_ALIGN - 1) / MEM_ALIGN * MEM_ALIGN)
+
+// Order keys: where the first node starts, and the spacing used for appends and prepends
+#define ORDER_START ((uint64_t)1 << 62)
+#define ORDER_GAP ((uint64_t)1 << 32)
+
+// Density limit for relabelling: a key range of 2^i holding fewer than (2 / ORDER_DENSITY)^i
+// nodes is sparse enough to spread them out in. Below 2^(1/32) so that 2^32 nodes fit.
+#define ORDER_DENSITY 1.4
+
+// Value index of an indexed list. Nodes are named by their slot in the node array.
+// The nodes holding a value are chained in list order, so the first one is the one
+// list_search returns, and prev lets a node be unlinked without walking the list.
+typedef struct NodeIndex {
+    uint32_t first[VALUE_COUNT];   // First node holding each value
+    uint32_t last[VALUE_COUNT];    // Last node holding each value
+    uint64_t* order;               // Per node: a key that grows along the list
+    uint32_t* prev;                // Per node: the node before it in the list
+    uint32_t* value_next;          // Per node: the next node holding the same value
+    uint32_t* value_prev;          // Per node: the previous node holding the same value
+} NodeIndex;
+
+// Nodes of a list set up by list_init: a slab of size / sizeof(Node) nodes in a pool of
+// its own. The slab's objects form the node array that index slots are counted in.
+typedef struct NodeStore {
+    Node** head;                // The head pointer passed to list_init
+    mem_pool_t* pool;           // Pool sized to fit the slab (and index) exactly
+    mem_slab_t* slab;           // Hands out the nodes (NULL if size was too small for one node)
+    Node* nodes;                // The slab's node array
+    Node* nodes_end;            // One past the last node
+    size_t free_count;          // Number of unused nodes
+    NodeIndex* index;           // Value index, NULL unless the list was created indexed
+    size_t index_size;          // Bytes taken by the index
+} NodeStore;
+
+// Stores of all lists between list_init and list_cleanup, in two tables sorted by
+// address: those with nodes by their node array, and all of them by their head pointer.
+// A head pointer can be passed to list_init again while its old list lives on (a helper
+// returning a list from a local head does that); the newer store then comes after the
+// older one in the head table, which stays reachable through its nodes.
+// Lookups take the lock shared, so threads working on lists of their own don't block each other.
+static NodeStore** stores_by_nodes = NULL;
+static NodeStore** stores_by_head = NULL;
+static size_t node_store_count = 0;
+static size_t store_count = 0;
+static size_t store_capacity = 0;
+static pthread_rwlock_t stores_lock = PTHREAD_RWLOCK_INITIALIZER;
+
+// Bumped whenever a store comes or goes
+static uint64_t store_generation = 1;
+
+// The store each thread found last, with copies of what identifies it, so that runs of
+// calls on one list skip the lock. It is only used while no store has come or gone since.
+typedef struct LastStore {
+    NodeStore* store;
+    Node** head;
+    Node* nodes;
+    Node* nodes_end;
+    uint64_t generation;
+} LastStore;
+static __thread LastStore last_store;
+
+// Address a store is sorted by in one of the tables
+static uintptr_t store_key(NodeStore* store, int by_head) {
+    return by_head ? (uintptr_t)store->head : (uintptr_t)store->nodes;
+}
+
+// Number of stores in a table sorted at or below an address (binary search)
+static size_t store_rank(NodeStore** table, size_t count, uintptr_t key, int by_head) {
+    size_t low = 0, high = count;
+    while (low < high) {
+        size_t mid = low + (high - low) / 2;
+        if (store_key(table[mid], by_head) <= key) low = mid + 1;
+        else high = mid;
+    }
+    return low;
+}
+
+// Put a store into a table at its place (stores_lock held for writing, room checked)
+static void table_insert(NodeStore** table, size_t* count, NodeStore* store, int by_head) {
+    size_t rank = store_rank(table, *count, store_key(store, by_head), by_head);
+    memmove(&table[rank + 1], &table[rank], (*count - rank) * sizeof(NodeStore*));
+    table[rank] = store;
+    (*count)++;
+}
+
+// Take a store out of a table (stores_lock held for writing). Stores sharing its
+// address sit right before it, so look back over those.
+static void table_remove(NodeStore** table, size_t* count, NodeStore* store, int by_head) {
+    uintptr_t key = store_key(store, by_head);
+    size_t rank = store_rank(table, *count, key, by_head);
+    while (rank > 0 && table[rank - 1] != store && store_key(table[rank - 1], by_head) == key) rank--;
+    if (rank == 0 || table[rank - 1] != store) return;
+    memmove(&table[rank - 1], &table[rank], (*count - rank) * sizeof(NodeStore*));
+    (*count)--;
+}
+
+// Find a list's store from one of its nodes, or else from its head pointer, in O(log lists)
+static NodeStore* store_find(Node** head, Node* node) {
+    // Step 0: Most calls work on the same list as this thread's call before
+    LastStore* last = &last_store;
+    if (last->generation == __atomic_load_n(&store_generation, __ATOMIC_ACQUIRE)) {
+        if (node ? node >= last->nodes && node < last->nodes_end : head && head == last->head) return last->store;
+    }
+
+    NodeStore* found = NULL;
+    pthread_rwlock_rdlock(&stores_lock);
+
+    // Step 1: The node belongs to the last store whose node array starts at or below it, if any
+    if (node) {
+        size_t rank = store_rank(stores_by_nodes, node_store_count, (uintptr_t)node, 0);
+        NodeStore* store = rank ? stores_by_nodes[rank - 1] : NULL;
+        if (store && node < store->nodes_end) found = store;
+    }
+
+    // Step 2: An empty list has no nodes, only its head pointer; the newest store for it wins
+    if (!found && head) {
+        size_t rank = store_rank(stores_by_head, store_count, (uintptr_t)head, 1);
+        NodeStore* store = rank ? stores_by_head[rank - 1] : NULL;
+        if (store && store->head == head) found = store;
+    }
+
+    if (found) {
+        last->store = found;
+        last->head = found->head;
+        last->nodes = found->nodes;
+        last->nodes_end = found->nodes_end;
+        last->generation = __atomic_load_n(&store_generation, __ATOMIC_RELAXED);
+    }
+    pthread_rwlock_unlock(&stores_lock);
+    return found;
+}
+
+// Add a store to the tables, making room first (0 if that fails)
+static int store_register(NodeStore* store) {
+    pthread_rwlock_wrlock(&stores_lock);
+    if (store_count == store_capacity) {
+        size_t capacity = store_capacity ? 2 * store_capacity : 16;
+        NodeStore** by_nodes = realloc(stores_by_nodes, capacity * sizeof(NodeStore*));
+        if (by_nodes) stores_by_nodes = by_nodes;
+        NodeStore** by_head = by_nodes ? realloc(stores_by_head, capacity * sizeof(NodeStore*)) : NULL;
+        if (by_head) stores_by_head = by_head;
+        if (!by_nodes || !by_head) {
+            pthread_rwlock_unlock(&stores_lock);
+            return 0;
+        }
+        store_capacity = capacity;
+    }
+
+    if (store->nodes) table_insert(stores_by_nodes, &node_store_count, store, 0);
+    table_insert(stores_by_head, &store_count, store, 1);
+    __atomic_add_fetch(&store_generation, 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&stores_lock);
+    return 1;
+}
+
+// Take a store out of the tables and release its pool, and with it every node of the list
+static void store_destroy(NodeStore* store) {
+    pthread_rwlock_wrlock(&stores_lock);
+    if (store->nodes) table_remove(stores_by_nodes, &node_store_count, store, 0);
+    table_remove(stores_by_head, &store_count, store, 1);
+    __atomic_add_fetch(&store_generation, 1, __ATOMIC_RELEASE);
+    pthread_rwlock_unlock(&stores_lock);
+
+    mem_pool_destroy(store->pool);
+    free(store);
+}
+
+// Set up the store for a list with room for size bytes worth of nodes, and optionally a value index.
+// The first used nodes are kept off the free list for the caller to fill in. Returns the store (NULL
+// if there was no memory for it). A store an earlier list_init set up for the head is left alone:
+// its list may still be in use under another head pointer.
+static NodeStore* store_setup(Node** head, size_t size, int indexed, size_t used) {
+    // Step 1: Set the head to NULL (empty list)
+    *head = NULL;
+
+    // Step 2: Give the list a pool of its own that fits exactly size / sizeof(Node) nodes
+    NodeStore* store = malloc(sizeof(NodeStore));
+    if (!store) {
+        fprintf(stderr, "Error: Memory allocation failed in list_init.\n");
+        return NULL;
+    }
+    size_t count = size / sizeof(Node);
+    if (count >= NO_NODE) indexed = 0;
+    store->head = head;
+    store->index_size = indexed ? sizeof(NodeIndex) + count * (sizeof(uint64_t) + 3 * sizeof(uint32_t)) : 0;
+    size_t slab_size = count ? mem_slab_size(sizeof(Node), count) : 0;
+    store->pool = mem_pool_create_fixed(slab_size + store->index_size + !count, 3);
+    if (!store->pool) {
+        fprintf(stderr, "Error: Memory allocation failed in list_init.\n");
+        free(store);
+        return NULL;
+    }
+
+    // Step 3: Carve the nodes out as a slab; a new slab hands them out lowest address
+    // first, so taking the first used ones leaves the rest to node_alloc
+    store->slab = count ? mem_pool_slab_create(store->pool, sizeof(Node), count) : NULL;
+    store->nodes = mem_slab_objects(store->slab);
+    store->nodes_end = store->nodes ? (Node*)((char*)store->nodes + count * NODE_STRIDE) : NULL;
+    store->free_count = store->nodes ? count : 0;
+    for (size_t i = 0; i < used && store->free_count; i++) {
+        mem_slab_alloc(store->slab);
+        store->free_count--;
+    }
+
+    // Step 4: The index follows the nodes in the same pool, with every value chain empty
+    store->index = indexed ? mem_pool_alloc(store->pool, store->index_size) : NULL;
+    if (store->index) {
+        NodeIndex* index = store->index;
+        memset(index->first, 0xFF, sizeof(index->first));
+        memset(index->last, 0xFF, sizeof(index->last));
+        index->order = (uint64_t*)(index + 1);
+        index->prev = (uint32_t*)(index->order + count);
+        index->value_next = index->prev + count;
+        index->value_prev = index->value_next + count;
+        memset(index->prev, 0xFF, count * sizeof(uint32_t));
+    }
+    if (!store->index) store->index_size = 0;
+
+    // Step 5: Remember the store until list_cleanup
+    if (!store_register(store)) {
+        fprintf(stderr, "Error: Memory allocation failed in list_init.\n");
+        mem_pool_destroy(store->pool);
+        free(store);
+        return NULL;
+    }
+    return store;
+}
+
+// Take a node from a list's store
+static Node* node_alloc(NodeStore* store) {
+    Node* node = store ? mem_slab_alloc(store->slab) : NULL;
+    if (node) store->free_count--;
+    return node;
+}
+
+// Give a node back to its list's store
+static void node_free(NodeStore* store, Node* node) {
+    if (!store) return;
+    mem_slab_free(store->slab, node);
+    store->free_count++;
+}
+
+// Slot of a node in the store's node array
+static uint32_t node_slot(NodeStore* store, Node* node) {
+    return node ? (uint32_t)(((char*)node - (char*)store->nodes) / NODE_STRIDE) : NO_NODE;
+}
+
+// Node in a slot of the store's node array
+static Node* slot_node(NodeStore* store, uint32_t slot) {
+    return slot == NO_NODE ? NULL : (Node*)((char*)store->nodes + slot * NODE_STRIDE);
+}
+
+// Make room for the order key of a node just linked in (order-maintenance relabelling).
+// Grow an aligned range of 2^bits keys around its neighbour, bits = 1, 2, ..., until the
+// nodes in it are sparse enough, then spread them out evenly over it. The nodes in a key
+// range sit next to each other in the list, so only they are walked: amortised O(log n).
+static void index_relabel(NodeStore* store, uint32_t slot) {
+    // Step 1: Start out with just the new node; its neighbours' keys are in order
+    NodeIndex* index = store->index;
+    uint32_t neighbour = index->prev[slot] != NO_NODE ? index->prev[slot] : node_slot(store, slot_node(store, slot)->next);
+    uint64_t anchor = index->order[neighbour];
+    uint32_t first = slot;
+    uint32_t last = slot;
+    size_t count = 1;
+    double limit = 1.0;
+
+    for (int bits = 1; bits <= 64; bits++) {
+        // Step 2: Take in the neighbours whose keys fall into the range, walking out both ways
+        uint64_t span = bits == 64 ? UINT64_MAX : (uint64_t)1 << bits;
+        uint64_t base = bits == 64 ? 0 : anchor & ~(span - 1);
+        uint32_t before = index->prev[first];
+        while (before != NO_NODE && index->order[before] - base < span) {
+            first = before;
+            before = index->prev[first];
+            count++;
+        }
+        uint32_t after = node_slot(store, slot_node(store, last)->next);
+        while (after != NO_NODE && index->order[after] - base < span) {
+            last = after;
+            after = node_slot(store, slot_node(store, last)->next);
+            count++;
+        }
+
+        // Step 3: Once they are sparse enough (or the range is all keys), spread them out evenly
+        limit *= 2.0 / ORDER_DENSITY;
+        if (count < limit || bits == 64) {
+            uint64_t gap = span / count;
+            uint64_t key = base + gap / 2;
+            for (Node* node = slot_node(store, first);; node = node->next) {
+                index->order[node_slot(store, node)] = key;
+                key += gap;
+                if (node == slot_node(store, last)) break;
+            }
+            return;
+        }
+    }
+}
+
+// Pick an order key between two neighbouring slots (0 if there is no room left)
+static uint64_t index_order_between(NodeIndex* index, uint32_t prev, uint32_t next) {
+    if (prev == NO_NODE && next == NO_NODE) return ORDER_START;
+
+    uint64_t low = prev == NO_NODE ? 0 : index->order[prev];
+    uint64_t high = next == NO_NODE ? UINT64_MAX : index->order[next];
+    if (next == NO_NODE && low < UINT64_MAX - ORDER_GAP) return low + ORDER_GAP;
+    if (prev == NO_NODE && high > ORDER_GAP) return high - ORDER_GAP;
+    return high - low >= 2 ? low + (high - low) / 2 : 0;
+}
+
+// Node of its value's chain that a node just linked in goes behind (NO_NODE: in front).
+// Four walks take turns: out from the node along the list both ways, looking for the
+// nearest node holding the same value, and in from both ends of the chain. The first one
+// to find the place wins, so a node near a chain end or near a node with its value is quick.
+static uint32_t index_chain_place(NodeStore* store, uint32_t slot) {
+    // Step 1: Appends and prepends, and chains that are still empty
+    NodeIndex* index = store->index;
+    uint16_t value = slot_node(store, slot)->data;
+    uint64_t key = index->order[slot];
+    uint32_t front = index->first[value];
+    uint32_t back = index->last[value];
+    if (back == NO_NODE || index->order[back] < key) return back;
+    if (index->order[front] > key) return NO_NODE;
+
+    // Step 2: Now order[front] < key < order[back], so no walk can run off its end
+    uint32_t left = index->prev[slot];
+    uint32_t right = node_slot(store, slot_node(store, slot)->next);
+    for (;;) {
+        if (slot_node(store, left)->data == value) return left;
+        if (slot_node(store, right)->data == value) return index->value_prev[right];
+        left = index->prev[left];
+        right = node_slot(store, slot_node(store, right)->next);
+
+        back = index->value_prev[back];
+        if (index->order[back] < key) return back;
+        uint32_t next = index->value_next[front];
+        if (index->order[next] > key) return front;
+        front = next;
+    }
+}
+
+// Record a node that was just linked into an indexed list behind prev_node (NULL at the head)
+static void index_link(NodeStore* store, Node* node, Node* prev_node) {
+    NodeIndex* index = store ? store->index : NULL;
+    if (!index) return;
+
+    // Step 1: Update the list neighbours
+    uint32_t slot = node_slot(store, node);
+    uint32_t prev = node_slot(store, prev_node);
+    uint32_t next = node_slot(store, node->next);
+    index->prev[slot] = prev;
+    if (next != NO_NODE) index->prev[next] = slot;
+
+    // Step 2: Give it an order key between its neighbours, spreading the keys around it out if there is no room
+    uint64_t key = index_order_between(index, prev, next);
+    if (key) {
+        index->order[slot] = key;
+    } else {
+        index_relabel(store, slot);
+    }
+
+    // Step 3: Find its place in the value's chain
+    uint16_t value = node->data;
+    uint32_t after = index_chain_place(store, slot);
+
+    // Step 4: Link it into the chain
+    uint32_t before = after == NO_NODE ? index->first[value] : index->value_next[after];
+    index->value_prev[slot] = after;
+    index->value_next[slot] = before;
+    if (after == NO_NODE) index->first[value] = slot;
+    else index->value_next[after] = slot;
+    if (before == NO_NODE) index->last[value] = slot;
+    else index->value_prev[before] = slot;
+}
+
+// Drop a node from the index of an indexed list before it is unlinked from the list
+static void index_unlink(NodeStore* store, Node* node) {
+    NodeIndex* index = store ? store->index : NULL;
+    if (!index) return;
+
+    // Step 1: The next node gets this node's predecessor
+    uint32_t slot = node_slot(store, node);
+    uint32_t next = node_slot(store, node->next);
+    if (next != NO_NODE) index->prev[next] = index->prev[slot];
+
+    // Step 2: Take it out of its value's chain
+    uint32_t value_prev = index->value_prev[slot];
+    uint32_t value_next = index->value_next[slot];
+    if (value_prev == NO_NODE) index->first[node->data] = value_next;
+    else index->value_next[value_prev] = value_next;
+    if (value_next == NO_NODE) index->last[node->data] = value_prev;
+    else index->value_prev[value_next] = value_prev;
+}
+
+// Initialize the list with room for size bytes worth of nodes
 void list_init(Node** head, size_t size) {
-    (void)size; // Ignore the size parameter (not used here)
-    *head = NULL; //Set the head to NULL (empty list)
+    store_setup(head, size, 0, 0);
 }
 
 // Insert a node at the end of the list
 void list_insert(Node** head, uint16_t data) {
-    // Step 1: Allocate memory for the new node
-    Node* new_node = (Node*)malloc(sizeof(Node));
+    // Step 1: Take a node from the list's pool
+    NodeStore* store = store_find(head, *head);
+    Node* new_node = node_alloc(store);
     if (!new_node) {
         fprintf(stderr, "Error: Memory allocation\n");
         return;
@@ -24,6 +432,7 @@ void list_insert(Node** head, uint16_t data) {
     // Step 3: If list is empty, new node becomes the head
     if (*head == NULL) {
         *head = new_node;
+        index_link(store, new_node, NULL);
     } else {
         // Step 4: Otherwise go to the end of the list
         Node* current = *head;
@@ -33,6 +442,7 @@ void list_insert(Node** head, uint16_t data) {
 
         // Step 5: Attach new node to the end
         current->next = new_node;
+        index_link(store, new_node, current);
     }
 }
 
@@ -44,8 +454,9 @@ void list_insert_after(Node* prev_node, uint16_t data) {
         return;
     }
 
-    // Step 2: Allocate memory for the new node
-    Node* new_node = (Node*)malloc(sizeof(Node));
+    // Step 2: Take a node from the list's pool
+    NodeStore* store = store_find(NULL, prev_node);
+    Node* new_node = node_alloc(store);
     if (!new_node) {
         fprintf(stderr, "Error: Memory allocation failed in list_insert_after.\n");
         return;
@@ -55,6 +466,7 @@ void list_insert_after(Node* prev_node, uint16_t data) {
     new_node->data = data;
     new_node->next = prev_node->next;
     prev_node->next = new_node;
+    index_link(store, new_node, prev_node);
 }
 
 // Insert a node before a specific node
@@ -66,8 +478,9 @@ void list_insert_before(Node** head, Node* next_node, uint16_t data) {
     }
 
     // Step 2: Special case: insert before head
+    NodeStore* store = store_find(head, *head);
     if (*head == next_node) {
-        Node* new_node = (Node*)malloc(sizeof(Node));
+        Node* new_node = node_alloc(store);
         if (!new_node) {
             fprintf(stderr, "Error: Memory allocation failed in list_insert_before.\n");
             return;
@@ -75,9 +488,13 @@ void list_insert_before(Node** head, Node* next_node, uint16_t data) {
         new_node->data = data;
         new_node->next = *head;
         *head = new_node;
+        index_link(store, new_node, NULL);
     } else {
-        // Step 3: Find the node before the target
+        // Step 3: Find the node before the target (an indexed list knows it)
         Node* current = *head;
+        if (store && store->index && next_node >= store->nodes && next_node < store->nodes_end) {
+            current = slot_node(store, store->index->prev[node_slot(store, next_node)]);
+        }
         while (current && current->next != next_node) {
             current = current->next;
         }
@@ -93,6 +510,109 @@ void list_insert_before(Node** head, Node* next_node, uint16_t data) {
     }
 }
 
+// Find the first node holding data and the node before it (NULL at the head)
+static Node* find_with_prev(NodeStore* store, Node** head, uint16_t data, Node** prev) {
+    // Step 1: An indexed list has the answer at hand
+    if (store && store->index) {
+        Node* node = slot_node(store, store->index->first[data]);
+        *prev = node ? slot_node(store, store->index->prev[node_slot(store, node)]) : NULL;
+        return node;
+    }
+
+    // Step 2: Otherwise traverse the list, keeping track of the previous node
+    Node* current = *head;
+    *prev = NULL;
+    while (current && current->data != data) {
+        *prev = current;
+        current = current->next;
+    }
+    return current;
+}
+
+// Take a node out of the list and give it back to the list's pool
+static void unlink_node(NodeStore* store, Node** head, Node* node, Node* prev) {
+    // Step 1: Keep the index up to date
+    index_unlink(store, node);
+
+    // Step 2: If the node is the head, move head to next
+    if (!prev) {
+        *head = node->next;
+    } else {
+        // Step 3: Skip over the node to delete it
+        prev->next = node->next;
+    }
+
+    // Step 4: Give the node back to the list's pool
+    node_free(store, node);
+}
+
+// Link n new nodes holding values behind last (NULL for an empty list) and return the new last node.
+// The caller has made sure the store has n unused nodes.
+static Node* append_nodes(NodeStore* store, Node** head, Node* last, const uint16_t* values, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        Node* node = node_alloc(store);
+        node->data = values[i];
+        node->next = NULL;
+        if (last) {
+            last->next = node;
+        } else {
+            *head = node;
+        }
+        index_link(store, node, last);
+        last = node;
+    }
+    return last;
+}
+
+// Predicate for deleting every node holding one value
+static int match_value(uint16_t data, void* value) {
+    return data == *(uint16_t*)value;
+}
+
+// Delete every node for which match returns non-zero, in one traversal.
+// Returns how many were deleted; *last is set to the last remaining node.
+static size_t delete_matching(NodeStore* store, Node** head, int (*match)(uint16_t, void*), void* ctx, Node** last) {
+    size_t removed = 0;
+    Node* prev = NULL;
+    Node* current = *head;
+
+    while (current) {
+        Node* next = current->next;
+        if (match(current->data, ctx)) {
+            unlink_node(store, head, current, prev);
+            removed++;
+        } else {
+            prev = current;
+        }
+        current = next;
+    }
+    if (last) *last = prev;
+    return removed;
+}
+
+// Delete every node holding value; an indexed list only visits those nodes.
+// If tail is given, it is moved to the node before the old tail if that gets deleted.
+static size_t delete_value(NodeStore* store, Node** head, uint16_t value, Node** tail) {
+    // Step 1: Without an index, go through the whole list once
+    if (!store || !store->index) {
+        Node* last;
+        size_t removed = delete_matching(store, head, match_value, &value, &last);
+        if (tail) *tail = last;
+        return removed;
+    }
+
+    // Step 2: With an index, unlink the value's chain from the front; each node's predecessor is known
+    size_t removed = 0;
+    Node* node;
+    while ((node = slot_node(store, store->index->first[value]))) {
+        Node* prev = slot_node(store, store->index->prev[node_slot(store, node)]);
+        if (tail && node == *tail) *tail = prev;
+        unlink_node(store, head, node, prev);
+        removed++;
+    }
+    return removed;
+}
+
 // Delete a node by its data value
 void list_delete(Node** head, uint16_t data) {
     // Step 1: Check if the list is empty
@@ -101,107 +621,205 @@ void list_delete(Node** head, uint16_t data) {
         return;
     }
 
-    // Step 2: Start from the head
-    Node* current = *head;
-    Node* prev = NULL;
-
-    // Step 3: Traverse to find the node with matching data
-    while (current && current->data != data) {
-        prev = current;
-        current = current->next;
-    }
+    // Step 2: Find the node with matching data
+    NodeStore* store = store_find(head, *head);
+    Node* prev;
+    Node* current = find_with_prev(store, head, data, &prev);
 
-    // Step 4: If not found, print error
+    // Step 3: If not found, print error
     if (!current) {
         fprintf(stderr, "Error: Data %u not found in list_delete.\n", data);
         return;
     }
 
-    // Step 5: If the node is the head, move head to next
-    if (!prev) {
-        *head = current->next;
-    } else {
-        // Step 6: Skip over the node to delete it
-        prev->next = current->next;
+    // Step 4: Unlink it and free it
+    unlink_node(store, head, current, prev);
+}
+
+// Insert n values at the end of the list, taking all nodes from the pool at once
+void list_insert_bulk(Node** head, const uint16_t* values, size_t n) {
+    // Step 1: Make sure every node is available before changing the list
+    NodeStore* store = store_find(head, *head);
+    if (!store || store->free_count < n) {
+        fprintf(stderr, "Error: Memory allocation failed in list_insert_bulk.\n");
+        return;
+    }
+
+    // Step 2: Go to the end of the list once
+    Node* last = *head;
+    while (last && last->next) {
+        last = last->next;
     }
 
-    // Step 7: Free memory
-    free(current);
+    // Step 3: Link all new nodes in a single pass
+    append_nodes(store, head, last, values, n);
+}
+
+// Delete every node holding data, in one traversal; returns how many were deleted
+size_t list_delete_all(Node** head, uint16_t data) {
+    return delete_value(store_find(head, *head), head, data, NULL);
+}
+
+// Delete every node for which match(data, ctx) returns non-zero, in one traversal
+size_t list_delete_if(Node** head, int (*match)(uint16_t data, void* ctx), void* ctx) {
+    return delete_matching(store_find(head, *head), head, match, ctx, NULL);
 }
 
 // Search for a node by its data value
 Node* list_search(Node** head, uint16_t data) {
-    // Step 1: Start at the head
+    // Step 1: An indexed list knows the first node holding each value
+    NodeStore* store = *head ? store_find(head, *head) : NULL;
+    if (store && store->index) {
+        return slot_node(store, store->index->first[data]);
+    }
+
+    // Step 2: Otherwise start at the head
     Node* current = *head;
 
-    // Step 2: Traverse the list to find the data
+    // Step 3: Traverse the list to find the data
     while (current) {
-        // Step 3: If node found, return it
+        // Step 4: If node found, return it
         if (current->data == data) {
             return current;
         }
         current = current->next;
     }
-    // Step 4: Node not found
+    // Step 5: Node not found
     return NULL;
 }
 
-// Display the whole list
-void list_display(Node** head) {
-    // Step 1: Print the opening bracket
-    printf("[");
-
-    // Step 2: Start at the head
-    Node* current = *head;
+// Where list_format and list_write put their text. In buffer mode the text is cut
+// off when buf is full; in streaming mode buf is handed to file or fd whenever it fills up.
+typedef struct ListWriter {
+    char* buf;
+    size_t cap;                 // Bytes buf can take (without the closing NUL in buffer mode)
+    size_t len;                 // Bytes in buf
+    size_t total;               // Bytes of text produced so far
+    FILE* file;                 // Streaming target, or NULL
+    int fd;                     // Streaming target if there is no file, -1 in buffer mode
+    int error;                  // 1 once a write failed
+} ListWriter;
 
-    // Step 3: Print each node’s data
-    while (current) {
-        printf("%u", current->data);
+// Size of the buffer the streaming functions collect text in
+#define WRITER_CHUNK 65536
 
-        // Step 4: Print a comma if there’s another node after
-        if (current->next) {
-            printf(", ");
+// Pass the collected text on to the stream
+static void writer_flush(ListWriter* w) {
+    if (w->file) {
+        if (fwrite(w->buf, 1, w->len, w->file) != w->len) w->error = 1;
+    } else {
+        size_t done = 0;
+        while (done < w->len) {
+            ssize_t n = write(w->fd, w->buf + done, w->len - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) {
+                w->error = 1;
+                break;
+            }
+            done += (size_t)n;
         }
-        current = current->next;
     }
+    w->len = 0;
+}
 
-    // Step 5: Print the closing bracket
-    printf("]");
+// Add n bytes of text; in buffer mode only what still fits (buf may be NULL if cap is 0)
+static void writer_put(ListWriter* w, const char* text, size_t n) {
+    w->total += n;
+    if (w->file || w->fd >= 0) {
+        if (w->len + n > w->cap) writer_flush(w);
+    } else if (w->len + n > w->cap) {
+        n = w->cap - w->len;
+    }
+    if (n) memcpy(w->buf + w->len, text, n);
+    w->len += n;
 }
 
-// Display a part of the list (range)
-void list_display_range(Node** head, Node* start_node, Node* end_node) {
-    // Step 1: If list is empty, print empty brackets
-    if (!*head) {
-        printf("[]");
+// Add a value as decimal digits
+static void writer_put_value(ListWriter* w, uint16_t value) {
+    char digits[5];
+    int n = 0;
+    do {
+        digits[4 - n++] = (char)('0' + value % 10);
+        value /= 10;
+    } while (value);
+    writer_put(w, digits + 5 - n, n);
+}
+
+// Write the list from start_node up to and including end_node (or to the end), as list_display_range prints it
+static void writer_range(ListWriter* w, Node* head, Node* start_node, Node* end_node) {
+    // Step 1: If list is empty, write empty brackets
+    if (!head) {
+        writer_put(w, "[]", 2);
         return;
     }
 
     // Step 2: If no start is given, start from the beginning
     if (!start_node) {
-        start_node = *head;
+        start_node = head;
     }
 
-    // Step 3: Print from start to end node
-    printf("[");
-    Node* current = start_node;
-    int first = 1;
-
-    while (current) {
-        if (!first) {
-            printf(", ");
+    // Step 3: Write each value from start to end node, separated by ", "
+    writer_put(w, "[", 1);
+    for (Node* current = start_node; current; current = current->next) {
+        if (current != start_node) {
+            writer_put(w, ", ", 2);
         }
-        printf("%u", current->data);
+        writer_put_value(w, current->data);
 
         if (current == end_node) {
             break;
         }
-        current = current->next;
-        first = 0;
     }
 
     // Step 4: Close the output
-    printf("]");
+    writer_put(w, "]", 1);
+}
+
+// Format a range into buf like snprintf: returns the full length, buf gets as much as fits plus a NUL
+static size_t format_range(Node* head, Node* start_node, Node* end_node, char* buf, size_t cap) {
+    ListWriter w = {buf, cap ? cap - 1 : 0, 0, 0, NULL, -1, 0};
+    writer_range(&w, head, start_node, end_node);
+    if (cap) buf[w.len] = '\0';
+    return w.total;
+}
+
+// Stream a range to a FILE* (or fd if file is NULL) in WRITER_CHUNK sized writes; 0 on success, -1 on error
+static int write_range(Node* head, Node* start_node, Node* end_node, FILE* file, int fd) {
+    char buf[WRITER_CHUNK];
+    ListWriter w = {buf, sizeof(buf), 0, 0, file, fd, 0};
+    writer_range(&w, head, start_node, end_node);
+    writer_flush(&w);
+    return w.error ? -1 : 0;
+}
+
+// Format the whole list as "[a, b, c]" into buf; returns the length the full text needs
+size_t list_format(Node** head, char* buf, size_t cap) {
+    return format_range(*head, NULL, NULL, buf, cap);
+}
+
+// Format a part of the list (range) into buf; returns the length the full text needs
+size_t list_format_range(Node** head, Node* start_node, Node* end_node, char* buf, size_t cap) {
+    return format_range(*head, start_node, end_node, buf, cap);
+}
+
+// Write the whole list to a stream
+int list_write(Node** head, FILE* file) {
+    return write_range(*head, NULL, NULL, file, -1);
+}
+
+// Write the whole list to a file descriptor
+int list_write_fd(Node** head, int fd) {
+    return write_range(*head, NULL, NULL, NULL, fd);
+}
+
+// Display the whole list
+void list_display(Node** head) {
+    write_range(*head, NULL, NULL, stdout, -1);
+}
+
+// Display a part of the list (range)
+void list_display_range(Node** head, Node* start_node, Node* end_node) {
+    write_range(*head, start_node, end_node, stdout, -1);
 }
 
 // Count how many nodes are in the list
@@ -222,16 +840,274 @@ int list_count_nodes(Node** head) {
 
 // Free all memory and clear the list
 void list_cleanup(Node** head) {
-    // Step 1: Start at the head
-    Node* current = *head;
+    // Step 1: Release the list's pool, which frees every node in one go
+    NodeStore* store = store_find(head, *head);
+    if (store) store_destroy(store);
 
-    // Step 2: Loop and free each node
-    while (current) {
-        Node* temp = current;
-        current = current->next;
-        free(temp);
+    // Step 2: Set head to NULL (empty list)
+    *head = NULL;
+}
+
+// Initialize a list descriptor with room for size bytes worth of nodes
+void list_create(List* list, size_t size) {
+    // Step 1: The nodes come from a pool the descriptor keeps hold of, so copies of it find it too
+    list->store = store_setup(&list->head, size, 0, 0);
+
+    // Step 2: Start out empty
+    list->tail = NULL;
+    list->count = 0;
+}
+
+// Add a node at the end of the list in O(1)
+void list_append(List* list, uint16_t data) {
+    // Step 1: Take a node from the list's pool
+    NodeStore* store = list->store;
+    Node* new_node = node_alloc(store);
+    if (!new_node) {
+        fprintf(stderr, "Error: Memory allocation failed in list_append.\n");
+        return;
+    }
+    new_node->data = data;
+    new_node->next = NULL;
+
+    // Step 2: Hang it behind the tail (or make it the head of an empty list)
+    if (list->tail) {
+        list->tail->next = new_node;
+    } else {
+        list->head = new_node;
+    }
+    index_link(store, new_node, list->tail);
+    list->tail = new_node;
+    list->count++;
+}
+
+// Add a node at the front of the list in O(1)
+void list_prepend(List* list, uint16_t data) {
+    // Step 1: Take a node from the list's pool
+    NodeStore* store = list->store;
+    Node* new_node = node_alloc(store);
+    if (!new_node) {
+        fprintf(stderr, "Error: Memory allocation failed in list_prepend.\n");
+        return;
+    }
+
+    // Step 2: Put it in front of the head; in an empty list it is the tail as well
+    new_node->data = data;
+    new_node->next = list->head;
+    list->head = new_node;
+    index_link(store, new_node, NULL);
+    if (!list->tail) list->tail = new_node;
+    list->count++;
+}
+
+// Append n values in O(n), taking all nodes from the pool at once
+void list_append_bulk(List* list, const uint16_t* values, size_t n) {
+    NodeStore* store = list->store;
+    if (!store || store->free_count < n) {
+        fprintf(stderr, "Error: Memory allocation failed in list_append_bulk.\n");
+        return;
+    }
+    if (n == 0) return;
+
+    list->tail = append_nodes(store, &list->head, list->tail, values, n);
+    list->count += n;
+}
+
+// Delete every node holding data, keeping tail and count up to date
+size_t list_remove_all(List* list, uint16_t data) {
+    size_t removed = delete_value(list->store, &list->head, data, &list->tail);
+    list->count -= removed;
+    return removed;
+}
+
+// Delete every node for which match(data, ctx) returns non-zero, keeping tail and count up to date
+size_t list_remove_if(List* list, int (*match)(uint16_t data, void* ctx), void* ctx) {
+    size_t removed = delete_matching(list->store, &list->head, match, ctx, &list->tail);
+    list->count -= removed;
+    return removed;
+}
+
+// Delete the first node holding data, keeping tail and count up to date
+void list_remove(List* list, uint16_t data) {
+    // Step 1: Find the node with matching data
+    NodeStore* store = list->store;
+    Node* prev;
+    Node* node = list->head ? find_with_prev(store, &list->head, data, &prev) : NULL;
+    if (!node) {
+        fprintf(stderr, "Error: Data %u not found in list_remove.\n", data);
+        return;
     }
 
-    // Step 3: Set head to NULL (empty list)
+    // Step 2: Unlink it and free it; the node before it may become the tail
+    if (node == list->tail) list->tail = prev;
+    unlink_node(store, &list->head, node, prev);
+    list->count--;
+}
+
+// Number of nodes in the list, in O(1)
+size_t list_count(List* list) {
+    return list->count;
+}
+
+// Initialize a list descriptor whose search and delete by value take O(1)
+// through an index of every value's nodes
+void list_create_indexed(List* list, size_t size) {
+    list->store = store_setup(&list->head, size, 1, 0);
+    list->tail = NULL;
+    list->count = 0;
+}
+
+// Bytes of memory the list's value index takes (0 for a list without one)
+size_t list_index_size(List* list) {
+    NodeStore* store = list->store;
+    return store ? store->index_size : 0;
+}
+
+// Free all memory and clear the list descriptor
+void list_destroy(List* list) {
+    // Step 1: Release the descriptor's pool, which frees every node in one go
+    if (list->store) store_destroy(list->store);
+
+    // Step 2: Clear the descriptor
+    list->store = NULL;
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+}
+
+// Snapshot file written by list_save: a header, then one record per node in list order.
+// Records link to each other by record number, so the file can be mapped anywhere.
+#define SNAPSHOT_MAGIC "LLSNAP1"
+
+typedef struct SnapshotHeader {
+    char magic[8];              // SNAPSHOT_MAGIC
+    uint64_t count;             // Number of records
+    uint32_t first;             // Record of the head node, NO_NODE for an empty list
+    uint32_t reserved;
+} SnapshotHeader;
+
+typedef struct SnapshotNode {
+    uint32_t next;              // Record of the next node, NO_NODE after the last one
+    uint16_t data;
+    uint16_t reserved;
+} SnapshotNode;
+
+// Records list_save collects before each write
+#define SNAPSHOT_CHUNK 8192
+
+// Write the list to a snapshot file in one pass; 0 on success, -1 on error
+int list_save(Node** head, const char* path) {
+    // Step 1: Create the file and leave room for the header, whose count is known only at the end
+    FILE* file = fopen(path, "wb");
+    if (!file) return -1;
+    SnapshotHeader header = {SNAPSHOT_MAGIC, 0, *head ? 0 : NO_NODE, 0};
+    int error = fwrite(&header, sizeof(header), 1, file) != 1;
+
+    // Step 2: Write the nodes in list order, so each record links to the one after it
+    SnapshotNode records[SNAPSHOT_CHUNK];
+    size_t filled = 0;
+    for (Node* current = *head; current && !error; current = current->next) {
+        if (header.count >= NO_NODE) {
+            error = 1;
+            break;
+        }
+        header.count++;
+        records[filled].next = current->next ? (uint32_t)header.count : NO_NODE;
+        records[filled].data = current->data;
+        records[filled].reserved = 0;
+        if (++filled == SNAPSHOT_CHUNK) {
+            error = fwrite(records, sizeof(SnapshotNode), filled, file) != filled;
+            filled = 0;
+        }
+    }
+    if (!error && filled) error = fwrite(records, sizeof(SnapshotNode), filled, file) != filled;
+
+    // Step 3: Fill in the count
+    if (!error) error = fseek(file, 0, SEEK_SET) != 0 || fwrite(&header, sizeof(header), 1, file) != 1;
+    if (fclose(file) != 0) error = 1;
+    return error ? -1 : 0;
+}
+
+// Map a snapshot file and turn it into a list with room for size bytes worth of nodes
+// (at least as many as the file holds). The nodes are filled straight from the mapping.
+// Returns the list's store; on error NULL, with the head set to NULL.
+static NodeStore* load_snapshot(Node** head, const char* path, size_t size, Node** tail, size_t* count) {
+    // Step 1: Map the file
     *head = NULL;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Error: Cannot open %s in list_load.\n", path);
+        return NULL;
+    }
+    struct stat st;
+    void* map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(SnapshotHeader)) {
+        map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, fd, 0);
+    }
+    close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "Error: Cannot map %s in list_load.\n", path);
+        return NULL;
+    }
+
+    // Step 2: Check the header against the file size and the room asked for
+    const SnapshotHeader* header = map;
+    const SnapshotNode* records = (const SnapshotNode*)(header + 1);
+    uint64_t n = header->count;
+    int valid = memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) == 0 && n < NO_NODE &&
+                (size_t)st.st_size == sizeof(SnapshotHeader) + n * sizeof(SnapshotNode) &&
+                header->first == (n ? 0 : NO_NODE);
+    if (!valid || size / sizeof(Node) < n) {
+        fprintf(stderr, "Error: %s in list_load.\n", valid ? "Not enough room" : "Invalid snapshot");
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    // Step 3: Set up the list and fill its first n nodes. list_save writes the records in
+    // list order, so each must link to the one after it; anything else (a cycle, say) is rejected.
+    NodeStore* store = store_setup(head, size, 0, n);
+    if (!store || (n && !store->nodes)) {
+        if (store) store_destroy(store);
+        munmap(map, st.st_size);
+        return NULL;
+    }
+    Node* first = slot_node(store, header->first);
+    Node* last = n ? slot_node(store, (uint32_t)(n - 1)) : NULL;
+    for (uint64_t i = 0; i < n; i++) {
+        uint32_t next = i + 1 < n ? (uint32_t)(i + 1) : NO_NODE;
+        if (records[i].next != next) {
+            valid = 0;
+            break;
+        }
+        Node* node = slot_node(store, (uint32_t)i);
+        node->data = records[i].data;
+        node->next = slot_node(store, next);
+    }
+    munmap(map, st.st_size);
+    if (!valid) {
+        fprintf(stderr, "Error: Invalid snapshot in list_load.\n");
+        store_destroy(store);
+        return NULL;
+    }
+
+    // Step 4: Hand out the list
+    *head = first;
+    if (tail) *tail = last;
+    if (count) *count = n;
+    return store;
+}
+
+// Load a list written by list_save, with room for size bytes worth of nodes.
+// Returns 0 on success; on error the list is left empty and -1 is returned.
+int list_load(Node** head, const char* path, size_t size) {
+    return load_snapshot(head, path, size, NULL, NULL) ? 0 : -1;
+}
+
+// Initialize a list descriptor from a file written by list_save; 0 on success, -1 on error
+int list_create_from_file(List* list, const char* path, size_t size) {
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+    list->store = load_snapshot(&list->head, path, size, &list->tail, &list->count);
+    return list->store ? 0 : -1;
 }
@@ -12,6 +12,24 @@ typedef struct Node {
     struct Node* next;
 } Node;
 
+// List descriptor: keeps the tail and the node count next to the head so that
+// appending and counting are O(1). Use it only through the list_* functions
+// taking a List*; the Node** functions don't keep tail and count up to date.
+// It holds on to the list's node pool, so a copy of it (say, returned from a
+// helper) works on the same list.
+typedef struct List {
+    Node* head;
+    Node* tail;
+    size_t count;
+    struct NodeStore* store;
+} List;
+
+// Each list_init gives the list a node pool of its own, until list_cleanup.
+// A list is found from its nodes, so a copy of a non-empty head pointer works
+// on the same list; an empty list is known only by the address passed to
+// list_init, so use an empty list through that variable (or use a List).
+// Calling list_init again starts a new list and leaves the old one alone.
+
 // Function prototypes
 void list_init(Node** head, size_t size);
 void list_insert(Node** head, uint16_t data);
@@ -24,4 +42,41 @@ void list_display_range(Node** head, Node* start_node, Node* end_node);
 int list_count_nodes(Node** head);
 void list_cleanup(Node** head);
 
+// Text output without a printf per node: list_format works like snprintf,
+// list_write and list_write_fd stream the text out in large chunks
+size_t list_format(Node** head, char* buf, size_t cap);
+size_t list_format_range(Node** head, Node* start_node, Node* end_node, char* buf, size_t cap);
+int list_write(Node** head, FILE* file);
+int list_write_fd(Node** head, int fd);
+
+// Bulk functions
+void list_insert_bulk(Node** head, const uint16_t* values, size_t n);
+size_t list_delete_all(Node** head, uint16_t data);
+size_t list_delete_if(Node** head, int (*match)(uint16_t data, void* ctx), void* ctx);
+
+// Descriptor functions
+void list_create(List* list, size_t size);
+void list_append(List* list, uint16_t data);
+void list_prepend(List* list, uint16_t data);
+void list_remove(List* list, uint16_t data);
+void list_append_bulk(List* list, const uint16_t* values, size_t n);
+size_t list_remove_all(List* list, uint16_t data);
+size_t list_remove_if(List* list, int (*match)(uint16_t data, void* ctx), void* ctx);
+size_t list_count(List* list);
+void list_destroy(List* list);
+
+// Snapshots: list_save writes a list to a file in one pass, list_load and
+// list_create_from_file map it back in without allocating node by node.
+// size is as for list_init and must cover at least the nodes in the file;
+// on error the list is left empty.
+int list_save(Node** head, const char* path);
+int list_load(Node** head, const char* path, size_t size);
+int list_create_from_file(List* list, const char* path, size_t size);
+
+// Indexed mode: list_search, list_delete and list_remove find values in O(1).
+// The index costs 512 KiB plus 20 bytes per node (see list_index_size), and
+// every insert and delete in linked_list.c keeps it up to date.
+void list_create_indexed(List* list, size_t size);
+size_t list_index_size(List* list);
+
 #endif // LINKED_LIST_H
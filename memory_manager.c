@@ -1,221 +1,1722 @@
+#define _GNU_SOURCE
 #include "memory_manager.h"
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <time.h>
+
+// Size classes: sizes below SL_COUNT get one class each, above that every
+// power of two is split into SL_COUNT equally wide classes.
+#define SL_BITS 2
+#define SL_COUNT (1 << SL_BITS)
+#define NUM_CLASSES 256
+#define BITMAP_WORDS (NUM_CLASSES / 64)
+
+// Offset index: hash buckets for the allocated blocks, keyed by offset
+#define INDEX_MIN_BITS 6
+
+// Lock-free index lookups give up (and take the lock) after this many steps
+#define INDEX_MAX_PROBE 64
+
+// MemBlock nodes reserved next to the pool, and added per growth step
+#define NODE_CHUNK 64
+
+// Per-thread caches for small blocks: one bin per TCACHE_STEP bytes up to TCACHE_MAX
+#define TCACHE_MAX 64
+#define TCACHE_STEP 16
+#define TCACHE_BINS (TCACHE_MAX / TCACHE_STEP)
+#define TCACHE_COUNT 16   // Blocks a thread may keep per bin
+#define TCACHE_BATCH 8    // Blocks moved to or from the pool per refill or spill
+
+// How pool_setup gets the pool's memory: malloc, or mmap with the MEM_MAP_* options
+#define POOL_MAPPED 0x100   // Map the pool with mmap
+#define POOL_SHARED 0x200   // Map it shared with processes forked later
+
+// Transparent huge page size a MEM_MAP_HUGEPAGES pool is aligned to
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+
+// A MEM_MAP_RELEASE pool hands free pages back to the OS only in runs of at least this many bytes
+#define RELEASE_MIN ((size_t)64 << 10)
+
+// Tells a block with a mapping of its own apart from other pointers
+#define LARGE_MAGIC 0x4C41524745424C4BULL
 
 // A struct to keep track of each block of memory
 typedef struct MemBlock {
-    size_t offset;          // Where in memory the block starts
-    size_t size;            // How big the block is
-    int is_free;            // 1 if the block is free, 0 if it's used
-    struct MemBlock* next;  // Pointer to the next block in the list
+    size_t offset;              // Where in memory the block starts
+    size_t size;                // How big the block is
+    int is_free;                // 1 if the block is free, 0 if it's used
+    int in_cache;               // 1 if the block is parked in a thread cache
+    struct MemBlock* next;      // Pointer to the next block in the list
+    struct MemBlock* prev;      // Pointer to the previous block in the list
+    struct MemBlock* next_free; // Next free block in the same size class
+    struct MemBlock* prev_free; // Previous free block in the same size class
+    struct MemBlock* hash_next; // Next allocated block in the same index bucket
 } MemBlock;
 
-// Global variables
-static char* memory_pool = NULL;     // The main memory area
-static size_t pool_size = 0;         // Total size of memory_pool
-static MemBlock* block_list = NULL;  // First block in the list
+// Offset index buckets. Replaced tables are kept until the pool is destroyed
+// so that lock-free readers never touch freed memory.
+typedef struct BlockIndex {
+    unsigned bits;              // log2 of the number of buckets
+    struct BlockIndex* retired; // The table this one replaced
+    MemBlock* buckets[];
+} BlockIndex;
 
-// Initialize the memory system
-void mem_init(size_t size) {
-    // Step 1: Allocate memory for the memory pool
-    memory_pool = malloc(size);
-    if (!memory_pool) {
-        fprintf(stderr, "Error: Could not allocate memory pool\n");
-        exit(EXIT_FAILURE);
+// Small allocated blocks a thread keeps for itself, so it can reuse them without the lock
+typedef struct ThreadCache {
+    MemBlock* bins[TCACHE_BINS][TCACHE_COUNT];
+    int counts[TCACHE_BINS];
+    size_t allocs;              // Blocks handed out and taken back by the cache itself,
+    size_t frees;               // counted here so the lock-free paths touch no shared line
+    struct mem_pool* pool;      // The pool the blocks belong to
+    struct ThreadCache* next;   // All caches of the pool, for mem_pool_destroy
+    struct ThreadCache* prev;
+} ThreadCache;
+
+// Header in front of a block that got a mapping of its own because it was at least
+// mmap_threshold bytes. The block starts LARGE_HEADER bytes into its first page, so
+// mem_free and mem_resize recognise one from the pointer alone.
+typedef struct LargeBlock {
+    uint64_t magic;             // LARGE_MAGIC
+    struct mem_pool* pool;      // The pool the block counts against
+    size_t length;              // Bytes mapped, header included
+    struct LargeBlock* next;    // All large blocks of the pool, for mem_pool_destroy
+    struct LargeBlock* prev;
+} LargeBlock;
+
+#define LARGE_HEADER ((sizeof(LargeBlock) + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1))
+
+// Extra MemBlock nodes allocated once the reserved ones run out
+typedef struct NodeChunk {
+    struct NodeChunk* next;
+    MemBlock nodes[NODE_CHUNK];
+} NodeChunk;
+
+// Everything that makes up one pool. It lives in the metadata region
+// behind the pool memory, so a pool is a single system allocation.
+struct mem_pool {
+    char* memory_pool;                     // The main memory area
+    size_t pool_size;                      // Total size of memory_pool
+    MemBlock* block_list;                  // First block in the list
+    MemBlock* last_block;                  // Last block in the list, where a growing pool adds memory
+
+    MemBlock* free_lists[NUM_CLASSES];     // Free blocks, one list per size class
+    uint64_t free_bitmap[BITMAP_WORDS];    // Bit set for every non-empty free list
+
+    BlockIndex* block_index;               // Allocated blocks hashed by offset
+    size_t index_count;                    // Number of blocks in the index
+
+    MemBlock* spare_nodes;                 // Unused MemBlock nodes, linked through next
+    NodeChunk* node_chunks;                // Node chunks allocated after creation
+    int fixed_metadata;                    // 1 if no metadata may be allocated after creation
+    int shared;                            // 1 if forked processes share the pool (no thread caches)
+    size_t mapped_size;                    // Bytes mapped for the pool and its metadata (0 if malloc'd)
+    size_t release_page;                   // Page size if free pages go back to the OS, else 0
+    size_t max_size;                       // Bytes reserved for a growable pool to grow into, else 0
+    size_t mmap_threshold;                 // Requests this big get a mapping of their own (0: never)
+    LargeBlock* large_blocks;              // Blocks that have a mapping of their own
+    struct mem_stats stats;                // Counters and free space; the rest is filled in by mem_pool_stats
+
+    pthread_mutex_t lock;                  // Guards everything above
+    pthread_key_t tcache_key;              // Each thread's ThreadCache for this pool
+    int tcache;                            // 1 if threads get small-block caches (tcache_key is set)
+    ThreadCache* tcache_list;              // Every ThreadCache handed out
+};
+
+// The pool behind mem_init/mem_alloc/mem_free/mem_resize/mem_deinit
+static mem_pool_t* default_pool = NULL;
+
+// Hand a MemBlock node back to the spare list
+static void node_release(mem_pool_t* pool, MemBlock* node) {
+    node->next = pool->spare_nodes;
+    pool->spare_nodes = node;
+}
+
+// Take a MemBlock node from the spare list, adding a chunk if allowed
+static MemBlock* node_alloc(mem_pool_t* pool) {
+    if (!pool->spare_nodes && !pool->fixed_metadata) {
+        NodeChunk* chunk = malloc(sizeof(NodeChunk));
+        if (chunk) {
+            chunk->next = pool->node_chunks;
+            pool->node_chunks = chunk;
+            for (int i = NODE_CHUNK - 1; i >= 0; i--) node_release(pool, &chunk->nodes[i]);
+        }
     }
 
-    // Step 2: Allocate a metadata block to represent the entire memory
-    block_list = malloc(sizeof(MemBlock));
-    if (!block_list) {
-        free(memory_pool);
-        fprintf(stderr, "Error: Could not allocate block list\n");
-        exit(EXIT_FAILURE);
+    MemBlock* node = pool->spare_nodes;
+    if (node) pool->spare_nodes = node->next;
+    return node;
+}
+
+// Map a size to the index of the size class that contains it
+static size_t size_class(size_t size) {
+    if (size < SL_COUNT) return size;
+
+    int fl = 63 - __builtin_clzll(size);
+    return (size_t)(fl - SL_BITS + 1) * SL_COUNT + ((size >> (fl - SL_BITS)) - SL_COUNT);
+}
+
+// First class in which every block is guaranteed to hold size bytes
+static size_t size_class_fit(size_t size) {
+    size_t cls = size_class(size);
+    if (size >= SL_COUNT) {
+        int fl = 63 - __builtin_clzll(size);
+        if (size & ((1ULL << (fl - SL_BITS)) - 1)) cls++;
     }
+    return cls;
+}
 
-    // Step 3: Set up the metadata for the first block
-    pool_size = size;
-    block_list->offset = 0;
-    block_list->size = size;
-    block_list->is_free = 1;
-    block_list->next = NULL;
+// Find the first non-empty size class at or above start, or -1 if none
+static int find_free_class(mem_pool_t* pool, size_t start) {
+    for (size_t w = start / 64; w < BITMAP_WORDS; w++) {
+        uint64_t bits = pool->free_bitmap[w];
+        if (w == start / 64) bits &= ~0ULL << (start % 64);
+        if (bits) return (int)(w * 64 + __builtin_ctzll(bits));
+    }
+    return -1;
 }
 
-// Allocate a block of memory
-void* mem_alloc(size_t size) {
+// Put a free block at the front of its size class list
+static void free_list_insert(mem_pool_t* pool, MemBlock* block) {
+    size_t cls = size_class(block->size);
+
+    block->prev_free = NULL;
+    block->next_free = pool->free_lists[cls];
+    if (pool->free_lists[cls]) pool->free_lists[cls]->prev_free = block;
+    pool->free_lists[cls] = block;
+    pool->free_bitmap[cls / 64] |= 1ULL << (cls % 64);
+    pool->stats.free_bytes += block->size;
+    pool->stats.free_blocks++;
+}
+
+// Take a free block out of its size class list
+static void free_list_remove(mem_pool_t* pool, MemBlock* block) {
+    size_t cls = size_class(block->size);
+
+    if (block->prev_free) {
+        block->prev_free->next_free = block->next_free;
+    } else {
+        pool->free_lists[cls] = block->next_free;
+        if (!pool->free_lists[cls]) pool->free_bitmap[cls / 64] &= ~(1ULL << (cls % 64));
+    }
+    if (block->next_free) block->next_free->prev_free = block->prev_free;
+    block->next_free = NULL;
+    block->prev_free = NULL;
+    pool->stats.free_bytes -= block->size;
+    pool->stats.free_blocks--;
+}
+
+// Find a free block of at least size bytes without walking block_list
+static MemBlock* find_free_block(mem_pool_t* pool, size_t size) {
+    // Step 1: Any block in a class at or above the fitting class is big enough
+    int cls = find_free_class(pool, size_class_fit(size));
+    if (cls >= 0) return pool->free_lists[cls];
+
+    // Step 2: The class holding size itself may still contain a large enough block
+    for (MemBlock* curr = pool->free_lists[size_class(size)]; curr; curr = curr->next_free) {
+        if (curr->size >= size) return curr;
+    }
+    return NULL;
+}
+
+// Bucket in the offset index for a given offset (Fibonacci hashing)
+static size_t index_slot(size_t offset, unsigned bits) {
+    return (size_t)((offset * 0x9E3779B97F4A7C15ULL) >> (64 - bits));
+}
+
+// Double the number of index buckets; on failure the old table is kept
+static void index_grow(mem_pool_t* pool) {
+    if (pool->fixed_metadata) return;
+
+    BlockIndex* old = pool->block_index;
+    unsigned bits = old->bits + 1;
+    BlockIndex* index = calloc(1, sizeof(BlockIndex) + ((size_t)1 << bits) * sizeof(MemBlock*));
+    if (!index) return;
+    index->bits = bits;
+    index->retired = old;
+
+    for (size_t i = 0; i < ((size_t)1 << old->bits); i++) {
+        MemBlock* curr = old->buckets[i];
+        while (curr) {
+            MemBlock* next = curr->hash_next;
+            size_t slot = index_slot(curr->offset, bits);
+            __atomic_store_n(&curr->hash_next, index->buckets[slot], __ATOMIC_RELEASE);
+            index->buckets[slot] = curr;
+            curr = next;
+        }
+    }
+    __atomic_store_n(&pool->block_index, index, __ATOMIC_RELEASE);
+}
+
+// Record an allocated block in the offset index
+static void index_insert(mem_pool_t* pool, MemBlock* block) {
+    if (pool->index_count >= ((size_t)1 << pool->block_index->bits)) index_grow(pool);
+
+    BlockIndex* index = pool->block_index;
+    MemBlock** bucket = &index->buckets[index_slot(block->offset, index->bits)];
+    __atomic_store_n(&block->hash_next, *bucket, __ATOMIC_RELEASE);
+    __atomic_store_n(bucket, block, __ATOMIC_RELEASE);
+    pool->index_count++;
+}
+
+// Drop a block from the offset index
+static void index_remove(mem_pool_t* pool, MemBlock* block) {
+    BlockIndex* index = pool->block_index;
+    MemBlock** link = &index->buckets[index_slot(block->offset, index->bits)];
+    while (*link != block) link = &(*link)->hash_next;
+    __atomic_store_n(link, block->hash_next, __ATOMIC_RELEASE);
+    pool->index_count--;
+}
+
+// Find the allocated block that starts at offset, or NULL
+static MemBlock* index_lookup(mem_pool_t* pool, size_t offset) {
+    BlockIndex* index = pool->block_index;
+    MemBlock* curr = index->buckets[index_slot(offset, index->bits)];
+    while (curr && curr->offset != offset) curr = curr->hash_next;
+    return curr;
+}
+
+// Same as index_lookup, but safe to call without the pool lock. It can miss
+// a block while the index is being changed, so a NULL needs a locked retry.
+// The node fields read here and in pool_free are only ever stored atomically.
+static MemBlock* index_lookup_unlocked(mem_pool_t* pool, size_t offset) {
+    BlockIndex* index = __atomic_load_n(&pool->block_index, __ATOMIC_ACQUIRE);
+    MemBlock* curr = __atomic_load_n(&index->buckets[index_slot(offset, index->bits)], __ATOMIC_ACQUIRE);
+
+    for (int steps = 0; curr && steps < INDEX_MAX_PROBE; steps++) {
+        if (__atomic_load_n(&curr->offset, __ATOMIC_RELAXED) == offset &&
+            !__atomic_load_n(&curr->is_free, __ATOMIC_RELAXED)) {
+            return curr;
+        }
+        curr = __atomic_load_n(&curr->hash_next, __ATOMIC_ACQUIRE);
+    }
+    return NULL;
+}
+
+// Fold a block into the block before it and release its metadata
+static void merge_with_prev(mem_pool_t* pool, MemBlock* block) {
+    MemBlock* prev = block->prev;
+    __atomic_store_n(&prev->size, prev->size + block->size, __ATOMIC_RELAXED);
+    prev->next = block->next;
+    if (block->next) block->next->prev = prev;
+    else pool->last_block = prev;
+    node_release(pool, block);
+    pool->stats.merges++;
+}
+
+// Check that a pointer points into the pool's memory
+static int in_pool(mem_pool_t* pool, void* ptr) {
+    size_t size = __atomic_load_n(&pool->pool_size, __ATOMIC_ACQUIRE);
+    return (char*)ptr >= pool->memory_pool && (char*)ptr < pool->memory_pool + size;
+}
+
+// Map a user pointer to its allocated block, or NULL if it isn't one
+static MemBlock* find_block(mem_pool_t* pool, void* ptr) {
+    if (!in_pool(pool, ptr)) return NULL;
+    return index_lookup(pool, (char*)ptr - pool->memory_pool);
+}
+
+// Cut a block down to size bytes and hand the rest back as a free block.
+// Without a spare node the block simply keeps the extra bytes.
+static void split_block(mem_pool_t* pool, MemBlock* block, size_t size) {
+    if (block->size <= size) return;
+
+    size_t rest = block->size - size;
+    MemBlock* next = block->next;
+
+    // The tail can simply grow into a free neighbour
+    if (next && next->is_free) {
+        free_list_remove(pool, next);
+        __atomic_store_n(&next->offset, next->offset - rest, __ATOMIC_RELAXED);
+        __atomic_store_n(&next->size, next->size + rest, __ATOMIC_RELAXED);
+        free_list_insert(pool, next);
+        __atomic_store_n(&block->size, size, __ATOMIC_RELAXED);
+        pool->stats.splits++;
+        return;
+    }
+
+    MemBlock* new_block = node_alloc(pool);
+    if (!new_block) return;
+
+    __atomic_store_n(&new_block->offset, block->offset + size, __ATOMIC_RELAXED);
+    __atomic_store_n(&new_block->size, rest, __ATOMIC_RELAXED);
+    __atomic_store_n(&new_block->is_free, 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&new_block->in_cache, 0, __ATOMIC_RELAXED);
+    new_block->next = next;
+    new_block->prev = block;
+    if (next) next->prev = new_block;
+    else pool->last_block = new_block;
+    free_list_insert(pool, new_block);
+
+    __atomic_store_n(&block->size, size, __ATOMIC_RELAXED);
+    block->next = new_block;
+    pool->stats.splits++;
+}
+
+// Bytes needed in front of offset to reach an address that is a multiple of align
+static size_t align_pad(mem_pool_t* pool, size_t offset, size_t align) {
+    return -(uintptr_t)(pool->memory_pool + offset) & (align - 1);
+}
+
+// Round size up to a multiple of MEM_ALIGN (0 if that overflows)
+static size_t align_size(size_t size) {
+    return size > SIZE_MAX - (MEM_ALIGN - 1) ? 0 : (size + MEM_ALIGN - 1) & ~(size_t)(MEM_ALIGN - 1);
+}
+
+// Give the first pad bytes of a free block (already off its free list) back as free space
+static int split_front(mem_pool_t* pool, MemBlock* block, size_t pad) {
+    MemBlock* prev = block->prev;
+
+    if (prev && prev->is_free) {
+        free_list_remove(pool, prev);
+        __atomic_store_n(&prev->size, prev->size + pad, __ATOMIC_RELAXED);
+        free_list_insert(pool, prev);
+    } else {
+        MemBlock* new_block = node_alloc(pool);
+        if (!new_block) return 0;
+
+        __atomic_store_n(&new_block->offset, block->offset, __ATOMIC_RELAXED);
+        __atomic_store_n(&new_block->size, pad, __ATOMIC_RELAXED);
+        __atomic_store_n(&new_block->is_free, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&new_block->in_cache, 0, __ATOMIC_RELAXED);
+        new_block->prev = prev;
+        new_block->next = block;
+        if (prev) prev->next = new_block;
+        else pool->block_list = new_block;
+        block->prev = new_block;
+        free_list_insert(pool, new_block);
+    }
+
+    __atomic_store_n(&block->offset, block->offset + pad, __ATOMIC_RELAXED);
+    __atomic_store_n(&block->size, block->size - pad, __ATOMIC_RELAXED);
+    pool->stats.splits++;
+    return 1;
+}
+
+// Find a free block that holds size bytes at an align boundary, checking each candidate's padding
+static MemBlock* find_aligned_block(mem_pool_t* pool, size_t size, size_t align) {
+    // Step 1: A block with room for the worst-case padding always works
+    MemBlock* curr = find_free_block(pool, size + align - MEM_ALIGN);
+    if (curr) return curr;
+
+    // Step 2: Otherwise look at the actual padding of every block that might fit
+    for (int cls = find_free_class(pool, size_class(size)); cls >= 0; cls = find_free_class(pool, cls + 1)) {
+        for (curr = pool->free_lists[cls]; curr; curr = curr->next_free) {
+            if (curr->size >= size + align_pad(pool, curr->offset, align)) return curr;
+        }
+        if (cls + 1 >= NUM_CLASSES) break;
+    }
+    return NULL;
+}
+
+// Make room for a request of need bytes in a growable pool by opening up more of its
+// reserved range: the pool at least doubles, up to max_size. The new chunk follows the
+// old memory, so every offset and pointer handed out stays valid. Returns 0 if it can't grow.
+static int pool_grow(mem_pool_t* pool, size_t need) {
+    // Step 1: Pick the new size, in whole pages
+    size_t old_size = pool->pool_size;
+    if (old_size >= pool->max_size) return 0;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t grow = need > old_size ? need : old_size;
+    if (grow > pool->max_size - old_size) grow = pool->max_size - old_size;
+    size_t new_size = old_size + ((grow + page - 1) & ~(page - 1));
+    if (new_size > pool->max_size) new_size = pool->max_size;
+
+    // Step 2: Make the chunk accessible
+    if (mprotect(pool->memory_pool + old_size, new_size - old_size, PROT_READ | PROT_WRITE) != 0) return 0;
+
+    // Step 3: Add it to the last block if that one is free, else make it a new free block
+    MemBlock* last = pool->last_block;
+    if (last->is_free) {
+        free_list_remove(pool, last);
+        __atomic_store_n(&last->size, last->size + new_size - old_size, __ATOMIC_RELAXED);
+        free_list_insert(pool, last);
+    } else {
+        MemBlock* chunk = node_alloc(pool);
+        if (!chunk) return 0;
+        __atomic_store_n(&chunk->offset, old_size, __ATOMIC_RELAXED);
+        __atomic_store_n(&chunk->size, new_size - old_size, __ATOMIC_RELAXED);
+        __atomic_store_n(&chunk->is_free, 1, __ATOMIC_RELAXED);
+        __atomic_store_n(&chunk->in_cache, 0, __ATOMIC_RELAXED);
+        chunk->next = NULL;
+        chunk->prev = last;
+        last->next = chunk;
+        pool->last_block = chunk;
+        free_list_insert(pool, chunk);
+    }
+    __atomic_store_n(&pool->pool_size, new_size, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Take a free block of at least size bytes and mark it as used (pool lock held)
+static MemBlock* block_alloc(mem_pool_t* pool, size_t size) {
+    // Step 1: Pick a free block that's big enough from the size class lists.
+    // Only the pool's last block can have an unaligned size; it may still be handed out whole.
+    size_t aligned = align_size(size);
+    MemBlock* curr = aligned ? find_free_block(pool, aligned) : NULL;
+    if (!curr && aligned && pool->max_size && pool_grow(pool, aligned)) {
+        curr = find_free_block(pool, aligned);
+    }
+    if (!curr) {
+        curr = find_free_block(pool, size);
+        if (!curr) return NULL;
+        aligned = curr->size;
+    }
+
+    // Step 2: Mark it as used and give any extra space back as a new free block
+    size = aligned;
+    free_list_remove(pool, curr);
+    __atomic_store_n(&curr->is_free, 0, __ATOMIC_RELAXED);
+    split_block(pool, curr, size);
+    index_insert(pool, curr);
+    return curr;
+}
+
+// Take a free block of at least size bytes starting at a multiple of align (pool lock held)
+static MemBlock* block_alloc_aligned(mem_pool_t* pool, size_t size, size_t align) {
+    // Step 1: Find a block that still fits once its start is moved up to the boundary
+    size = align_size(size);
+    if (!size || size > SIZE_MAX - align) return NULL;
+    MemBlock* curr = find_aligned_block(pool, size, align);
+    if (!curr && pool->max_size && pool_grow(pool, size + align)) {
+        curr = find_aligned_block(pool, size, align);
+    }
+    if (!curr) return NULL;
+
+    // Step 2: Hand the padding in front of the boundary back to the free lists
+    free_list_remove(pool, curr);
+    size_t pad = align_pad(pool, curr->offset, align);
+    if (pad && !split_front(pool, curr, pad)) {
+        free_list_insert(pool, curr);
+        return NULL;
+    }
+
+    // Step 3: Mark it as used and give any extra space at the end back as well
+    __atomic_store_n(&curr->is_free, 0, __ATOMIC_RELAXED);
+    split_block(pool, curr, size);
+    index_insert(pool, curr);
+    return curr;
+}
+
+// Hand the pages of a free block that overlap the freed bytes [from, to) back to the OS.
+// Only whole pages of the block count, so a partly used page or the metadata behind
+// the pool memory is never touched; the pages read back as zeros once used again.
+static void release_pages(mem_pool_t* pool, MemBlock* block, size_t from, size_t to) {
+    size_t page = pool->release_page;
+    size_t low = (block->offset + page - 1) & ~(page - 1);
+    size_t high = (block->offset + block->size) & ~(page - 1);
+    if (low < (from & ~(page - 1))) low = from & ~(page - 1);
+    if (high > ((to + page - 1) & ~(page - 1))) high = (to + page - 1) & ~(page - 1);
+    if (high > low && high - low >= RELEASE_MIN) {
+        madvise(pool->memory_pool + low, high - low, MADV_DONTNEED);
+    }
+}
+
+// Give a used block back to the pool and merge it with free neighbours (pool lock held)
+static void block_free(mem_pool_t* pool, MemBlock* curr) {
+    // Step 1: Mark the block as free
+    index_remove(pool, curr);
+    __atomic_store_n(&curr->is_free, 1, __ATOMIC_RELAXED);
+    size_t from = curr->offset;
+    size_t to = curr->offset + curr->size;
+
+    // Step 2: Merge with next block if it's free
+    if (curr->next && curr->next->is_free) {
+        free_list_remove(pool, curr->next);
+        merge_with_prev(pool, curr->next);
+    }
+
+    // Step 3: Merge with previous block if it's free
+    if (curr->prev && curr->prev->is_free) {
+        MemBlock* prev = curr->prev;
+        free_list_remove(pool, prev);
+        merge_with_prev(pool, curr);
+        curr = prev;
+    }
+
+    // Step 4: File the (possibly merged) block under its new size class
+    free_list_insert(pool, curr);
+
+    // Step 5: Let the OS take back the pages nothing uses any more
+    if (pool->release_page) release_pages(pool, curr, from, to);
+}
+
+// The calling thread's cache for a pool, created on first use (NULL if that fails)
+static ThreadCache* tcache_get(mem_pool_t* pool) {
+    ThreadCache* tc = pthread_getspecific(pool->tcache_key);
+    if (tc) return tc;
+
+    tc = calloc(1, sizeof(ThreadCache));
+    if (!tc) return NULL;
+    tc->pool = pool;
+
+    pthread_mutex_lock(&pool->lock);
+    tc->next = pool->tcache_list;
+    if (pool->tcache_list) pool->tcache_list->prev = tc;
+    pool->tcache_list = tc;
+    pthread_mutex_unlock(&pool->lock);
+
+    pthread_setspecific(pool->tcache_key, tc);
+    return tc;
+}
+
+// Hand every block in a cache back to the pool (pool lock held)
+static void tcache_flush(ThreadCache* tc) {
+    for (int bin = 0; bin < TCACHE_BINS; bin++) {
+        while (tc->counts[bin] > 0) {
+            MemBlock* block = tc->bins[bin][--tc->counts[bin]];
+            __atomic_store_n(&block->in_cache, 0, __ATOMIC_RELAXED);
+            block_free(tc->pool, block);
+        }
+    }
+}
+
+// Thread exit: give the cached blocks back and drop the cache
+static void tcache_release(void* arg) {
+    ThreadCache* tc = arg;
+    mem_pool_t* pool = tc->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    tcache_flush(tc);
+    pool->stats.allocs += tc->allocs;
+    pool->stats.frees += tc->frees;
+    if (tc->prev) tc->prev->next = tc->next;
+    else pool->tcache_list = tc->next;
+    if (tc->next) tc->next->prev = tc->prev;
+    pthread_mutex_unlock(&pool->lock);
+
+    free(tc);
+}
+
+// Fill an empty bin with a batch of blocks from the pool
+static void tcache_refill(ThreadCache* tc, int bin) {
+    mem_pool_t* pool = tc->pool;
+    MemBlock* batch[TCACHE_BATCH];
+    int got = 0;
+
+    pthread_mutex_lock(&pool->lock);
+    while (got < TCACHE_BATCH && (batch[got] = block_alloc(pool, (size_t)(bin + 1) * TCACHE_STEP))) got++;
+    pthread_mutex_unlock(&pool->lock);
+
+    // Lowest address on top, so blocks are handed out in the order the pool gave them
+    while (got > 0) {
+        MemBlock* block = batch[--got];
+        __atomic_store_n(&block->in_cache, 1, __ATOMIC_RELAXED);
+        tc->bins[bin][tc->counts[bin]++] = block;
+    }
+}
+
+// Give the oldest half of a full bin back to the pool
+static void tcache_spill(ThreadCache* tc, int bin) {
+    mem_pool_t* pool = tc->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    for (int i = 0; i < TCACHE_BATCH; i++) {
+        __atomic_store_n(&tc->bins[bin][i]->in_cache, 0, __ATOMIC_RELAXED);
+        block_free(pool, tc->bins[bin][i]);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    tc->counts[bin] -= TCACHE_BATCH;
+    memmove(tc->bins[bin], tc->bins[bin] + TCACHE_BATCH, tc->counts[bin] * sizeof(MemBlock*));
+}
+
+// Map total bytes for a pool. Private mappings are committed page by page on first
+// touch; with MEM_MAP_HUGEPAGES the region starts on a huge page boundary.
+static char* region_map(size_t total, unsigned map) {
+    // Step 1: Reserve the range, with room to move the start up to a huge page boundary
+    size_t extra = map & MEM_MAP_HUGEPAGES ? HUGE_PAGE_SIZE : 0;
+    int flags = map & POOL_SHARED ? MAP_SHARED | MAP_ANONYMOUS : MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE;
+    char* memory = mmap(NULL, total + extra, PROT_READ | PROT_WRITE, flags, -1, 0);
+    if (memory == MAP_FAILED) return NULL;
+    if (!extra) return memory;
+
+    // Step 2: Unmap what lies before the boundary and after the region
+    char* aligned = (char*)(((uintptr_t)memory + extra - 1) & ~(uintptr_t)(extra - 1));
+    if (aligned > memory) munmap(memory, aligned - memory);
+    if (memory + extra > aligned) munmap(aligned + total, memory + extra - aligned);
+
+    // Step 3: Ask for huge pages where the kernel supports them
+#ifdef MADV_HUGEPAGE
+    madvise(aligned, total, MADV_HUGEPAGE);
+#endif
+    return aligned;
+}
+
+// Set up a pool with a metadata region for max_blocks nodes behind it
+// (max_blocks == 0 reserves one chunk and lets the metadata grow later).
+// map is 0 to malloc the pool, or POOL_MAPPED with options to mmap it; a
+// POOL_SHARED pool is mapped MAP_SHARED, so processes forked later see the
+// same memory and metadata at the same addresses.
+static mem_pool_t* pool_setup(size_t size, size_t max_blocks, unsigned map) {
+    // Step 1: Work out the layout; metadata starts on a cache line after the pool memory
+    size_t nodes = max_blocks ? max_blocks : NODE_CHUNK;
+    unsigned bits = INDEX_MIN_BITS;
+    while (max_blocks && ((size_t)1 << bits) < max_blocks) bits++;
+
+    size_t meta_offset = (size + 63) & ~(size_t)63;
+    size_t nodes_offset = meta_offset + ((sizeof(mem_pool_t) + 63) & ~(size_t)63);
+    size_t index_size = max_blocks ? sizeof(BlockIndex) + ((size_t)1 << bits) * sizeof(MemBlock*) : 0;
+
+    // Step 2: Allocate memory for the memory pool and its metadata in one go
+    size_t total = nodes_offset + nodes * sizeof(MemBlock) + index_size;
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    char* memory;
+    if (map) {
+        total = (total + page - 1) & ~(page - 1);
+        memory = region_map(total, map);
+    } else {
+        memory = malloc(total);
+    }
+    if (!memory) return NULL;
+
+    mem_pool_t* pool = (mem_pool_t*)(memory + meta_offset);
+    memset(pool, 0, sizeof(mem_pool_t));
+    pool->memory_pool = memory;
+    pool->pool_size = size;
+    pool->shared = (map & POOL_SHARED) != 0;
+    pool->mapped_size = map ? total : 0;
+    pool->release_page = map & MEM_MAP_RELEASE ? page : 0;
+
+    // Step 3: Put every reserved node on the spare list
+    MemBlock* reserved = (MemBlock*)(memory + nodes_offset);
+    pool->fixed_metadata = max_blocks != 0;
+    for (size_t i = nodes; i > 0; i--) node_release(pool, &reserved[i - 1]);
+
+    // Step 4: Set up an empty offset index for the allocated blocks
+    if (pool->fixed_metadata) {
+        pool->block_index = (BlockIndex*)(reserved + nodes);
+        memset(pool->block_index, 0, index_size);
+    } else {
+        pool->block_index = calloc(1, sizeof(BlockIndex) + ((size_t)1 << bits) * sizeof(MemBlock*));
+        if (!pool->block_index) {
+            if (map) munmap(memory, total);
+            else free(memory);
+            return NULL;
+        }
+    }
+    pool->block_index->bits = bits;
+
+    // Step 5: Set up the metadata for the first block
+    MemBlock* first = node_alloc(pool);
+    first->offset = 0;
+    first->size = size;
+    first->is_free = 1;
+    first->in_cache = 0;
+    first->next = NULL;
+    first->prev = NULL;
+    pool->block_list = first;
+    pool->last_block = first;
+
+    // Step 6: The whole pool starts out as one free block
+    free_list_insert(pool, first);
+
+    // Step 7: Every thread gets its own small-block cache on first use. A shared pool
+    // has none, since a cache would hide blocks from the other processes, and neither
+    // has a fixed-metadata pool, which must not malloc caches or spend nodes on them.
+    // Pools beyond the system's limit on thread keys go without as well.
+    if (pool->shared) {
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutex_init(&pool->lock, &attr);
+        pthread_mutexattr_destroy(&attr);
+    } else {
+        pthread_mutex_init(&pool->lock, NULL);
+        pool->tcache = !pool->fixed_metadata && pthread_key_create(&pool->tcache_key, tcache_release) == 0;
+    }
+    return pool;
+}
+
+// Create an independent pool of the given size
+mem_pool_t* mem_pool_create(size_t size) {
+    return pool_setup(size, 0, 0);
+}
+
+// Create a pool whose memory is reserved with mmap and committed as it is used
+mem_pool_t* mem_pool_create_mapped(size_t size, unsigned flags) {
+    return pool_setup(size, 0, POOL_MAPPED | (flags & (MEM_MAP_HUGEPAGES | MEM_MAP_RELEASE)));
+}
+
+// Create a pool that starts at size bytes and grows on demand up to max_size
+mem_pool_t* mem_pool_create_growable(size_t size, size_t max_size, unsigned flags) {
+    // Step 1: Reserve max_size bytes; whole pages keep every chunk boundary aligned
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size = (size + page - 1) & ~(page - 1);
+    if (!size) size = page;
+    if (max_size < size) max_size = size;
+    if (max_size > SIZE_MAX - page) return NULL;
+    max_size = (max_size + page - 1) & ~(page - 1);
+    mem_pool_t* pool = pool_setup(max_size, 0, POOL_MAPPED | (flags & (MEM_MAP_HUGEPAGES | MEM_MAP_RELEASE)));
+    if (!pool) return NULL;
+
+    // Step 2: Only the first size bytes are in use; the rest can't be touched until the pool grows
+    MemBlock* first = pool->block_list;
+    free_list_remove(pool, first);
+    first->size = size;
+    free_list_insert(pool, first);
+    pool->pool_size = size;
+    pool->max_size = max_size;
+    if (max_size > size) mprotect(pool->memory_pool + size, max_size - size, PROT_NONE);
+    return pool;
+}
+
+// Create an independent pool with all block metadata reserved up front
+mem_pool_t* mem_pool_create_fixed(size_t size, size_t max_blocks) {
+    return pool_setup(size, max_blocks ? max_blocks : 1, 0);
+}
+
+// Create a pool shared with processes forked after this call; its metadata
+// can't grow, as anything malloc'd later would be private to one process
+mem_pool_t* mem_pool_create_shared(size_t size, size_t max_blocks) {
+    return pool_setup(size, max_blocks ? max_blocks : 1, POOL_MAPPED | POOL_SHARED);
+}
+
+// Map a large block with its header in front; it still has to be linked to the pool
+static LargeBlock* large_map(mem_pool_t* pool, size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > SIZE_MAX - LARGE_HEADER - page) return NULL;
+    size_t length = (size + LARGE_HEADER + page - 1) & ~(page - 1);
+    LargeBlock* large = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (large == MAP_FAILED) return NULL;
+
+    large->magic = LARGE_MAGIC;
+    large->pool = pool;
+    large->length = length;
+    return large;
+}
+
+// The header of a pool's large block, or NULL if ptr isn't one. Pointers into the
+// pool's own address range (a growable pool's PROT_NONE tail included) are never
+// large blocks, and the header is only read once mincore has found its page mapped,
+// so a block that was already unmapped (a double free) is ignored as well.
+static LargeBlock* large_block(mem_pool_t* pool, void* ptr) {
+    // Step 1: A large block starts LARGE_HEADER bytes into a page outside the pool
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (((uintptr_t)ptr & (page - 1)) != LARGE_HEADER) return NULL;
+    size_t reserved = pool->max_size ? pool->max_size : __atomic_load_n(&pool->pool_size, __ATOMIC_ACQUIRE);
+    if ((char*)ptr >= pool->memory_pool && (char*)ptr < pool->memory_pool + reserved) return NULL;
+
+    // Step 2: Only read the header if its page is mapped
+    LargeBlock* large = (LargeBlock*)((char*)ptr - LARGE_HEADER);
+    unsigned char resident;
+    if (mincore(large, page, &resident) != 0) return NULL;
+    return large->magic == LARGE_MAGIC && large->pool == pool ? large : NULL;
+}
+
+// Take a large block off the pool's list (pool lock held)
+static void large_unlink(mem_pool_t* pool, LargeBlock* large) {
+    if (large->prev) large->prev->next = large->next;
+    else pool->large_blocks = large->next;
+    if (large->next) large->next->prev = large->prev;
+    pool->stats.large_blocks--;
+    pool->stats.large_bytes -= large->length;
+}
+
+// Put a large block (back) on the pool's list (pool lock held)
+static void large_link(mem_pool_t* pool, LargeBlock* large) {
+    large->prev = NULL;
+    large->next = pool->large_blocks;
+    if (pool->large_blocks) pool->large_blocks->prev = large;
+    pool->large_blocks = large;
+    pool->stats.large_blocks++;
+    pool->stats.large_bytes += large->length;
+}
+
+// Unmap a large block
+static void large_free(mem_pool_t* pool, LargeBlock* large) {
+    pthread_mutex_lock(&pool->lock);
+    large_unlink(pool, large);
+    pool->stats.frees++;
+    pthread_mutex_unlock(&pool->lock);
+    large->magic = 0;
+    munmap(large, large->length);
+}
+
+// Resize a large block with mremap, so the kernel moves page table entries instead
+// of copying the data; the block only moves if the mapping can't grow where it is
+static void* large_resize(mem_pool_t* pool, LargeBlock* large, size_t size, enum mem_resize_how* how) {
+    // Step 1: Work out the new length; if it doesn't change there is nothing to do
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    *how = MEM_RESIZE_FAILED;
+    if (size > SIZE_MAX - LARGE_HEADER - page) return NULL;
+    size_t length = (size + LARGE_HEADER + page - 1) & ~(page - 1);
+    if (length == large->length) {
+        pthread_mutex_lock(&pool->lock);
+        pool->stats.resizes_in_place++;
+        pthread_mutex_unlock(&pool->lock);
+        *how = MEM_RESIZE_IN_PLACE;
+        return (char*)large + LARGE_HEADER;
+    }
+
+    // Step 2: Remap with the block off the list, as its header may move
+    pthread_mutex_lock(&pool->lock);
+    large_unlink(pool, large);
+    pthread_mutex_unlock(&pool->lock);
+    LargeBlock* moved = mremap(large, large->length, length, MREMAP_MAYMOVE);
+
+    // Step 3: Put it back, moved or not
+    pthread_mutex_lock(&pool->lock);
+    if (moved == MAP_FAILED) {
+        large_link(pool, large);
+        pool->stats.failed_allocs++;
+        pthread_mutex_unlock(&pool->lock);
+        return NULL;
+    }
+    moved->length = length;
+    large_link(pool, moved);
+    if (moved == large) pool->stats.resizes_in_place++;
+    else pool->stats.resizes_moved++;
+    pthread_mutex_unlock(&pool->lock);
+    *how = moved == large ? MEM_RESIZE_IN_PLACE : MEM_RESIZE_REMAPPED;
+    return (char*)moved + LARGE_HEADER;
+}
+
+// Move a large block that has shrunk below mmap_threshold into the pool (pool lock held).
+// If the pool has no room it simply stays where it is, which is fine as it only shrinks.
+static void* large_shrink(mem_pool_t* pool, LargeBlock* large, size_t size, enum mem_resize_how* how) {
+    void* ptr = (char*)large + LARGE_HEADER;
+    size_t usable = large->length - LARGE_HEADER;
+    MemBlock* block = block_alloc(pool, size);
+    if (!block) {
+        pool->stats.resizes_in_place++;
+        *how = MEM_RESIZE_IN_PLACE;
+        return ptr;
+    }
+
+    void* new_ptr = pool->memory_pool + block->offset;
+    memcpy(new_ptr, ptr, size < usable ? size : usable);
+    large_unlink(pool, large);
+    munmap(large, large->length);
+    pool->stats.resizes_moved++;
+    *how = MEM_RESIZE_MOVED;
+    return new_ptr;
+}
+
+// Size to give a block that grows to size bytes: the start of the next size class,
+// up to 1/SL_COUNT more, so that a block that keeps growing mostly does so in place.
+// Thread-cache sizes are left alone.
+static size_t grow_headroom(size_t size) {
+    if (size <= TCACHE_MAX) return size;
+
+    size_t step = (size_t)1 << (63 - __builtin_clzll(size) - SL_BITS);
+    size_t roomy = (size + step - 1) & ~(step - 1);
+    return roomy < size ? size : roomy;
+}
+
+// Resize a block in place or move it (pool lock held)
+static void* resize_locked(mem_pool_t* pool, void* ptr, size_t size, enum mem_resize_how* how) {
+    // Step 1: Find the block that starts at this pointer; if there is none, return NULL
+    *how = MEM_RESIZE_FAILED;
+    MemBlock* curr = find_block(pool, ptr);
+    if (!curr || curr->in_cache) return NULL;
+
+    // Step 2: If current block is big enough, try shrink it (keeping the size aligned)
+    size_t aligned = align_size(size);
+    if (aligned && curr->size >= aligned) {
+        split_block(pool, curr, aligned);
+        pool->stats.resizes_in_place++;
+        *how = MEM_RESIZE_IN_PLACE;
+        return ptr;
+    }
+    if (curr->size >= size) {
+        pool->stats.resizes_in_place++;
+        *how = MEM_RESIZE_IN_PLACE;
+        return ptr;
+    }
+
+    // A growing block keeps some headroom for the next time it grows
+    size_t roomy = aligned ? grow_headroom(aligned) : size;
+
+    // Step 3: Check if the next block is free and we can join it with this one to make enough space
+    MemBlock* next = curr->next && curr->next->is_free ? curr->next : NULL;
+    if (next && (curr->size + next->size) >= size) {
+
+        free_list_remove(pool, next);
+        merge_with_prev(pool, next);
+
+        // Step 4: After merging; if we now have more space than we need, split off the extra into a new free block
+        if (aligned) split_block(pool, curr, roomy);
+
+        pool->stats.resizes_in_place++;
+        *how = MEM_RESIZE_IN_PLACE;
+        return ptr;
+    }
+
+    // Step 5: Otherwise take the free block in front as well (and the one behind, if free),
+    // shifting the data down with memmove; that copies no more than moving would
+    MemBlock* prev = curr->prev && curr->prev->is_free ? curr->prev : NULL;
+    if (prev && prev->size + curr->size + (next ? next->size : 0) >= size) {
+        void* new_ptr = pool->memory_pool + prev->offset;
+        memmove(new_ptr, ptr, curr->size);
+
+        // Mark the block free before its node goes back to the node slab, as block_free does,
+        // so a lock-free lookup still walking an old hash chain skips the node
+        index_remove(pool, curr);
+        __atomic_store_n(&curr->is_free, 1, __ATOMIC_RELAXED);
+        free_list_remove(pool, prev);
+        if (next) {
+            free_list_remove(pool, next);
+            merge_with_prev(pool, next);
+        }
+        merge_with_prev(pool, curr);
+        __atomic_store_n(&prev->is_free, 0, __ATOMIC_RELAXED);
+        index_insert(pool, prev);
+        if (aligned) split_block(pool, prev, roomy);
+
+        pool->stats.resizes_shifted++;
+        *how = MEM_RESIZE_SHIFTED;
+        return new_ptr;
+    }
+
+    // Step 6: If we still doesnt fit in place, try to allocate to a new bigger block somewhere else;
+    // a block that has grown past mmap_threshold gets a mapping of its own
+    void* new_ptr = NULL;
+    if (pool->mmap_threshold && size >= pool->mmap_threshold) {
+        LargeBlock* large = large_map(pool, size);
+        if (large) {
+            large_link(pool, large);
+            new_ptr = (char*)large + LARGE_HEADER;
+        }
+    } else {
+        MemBlock* new_block = block_alloc(pool, roomy);
+        if (!new_block && roomy != size) new_block = block_alloc(pool, size);
+        if (new_block) new_ptr = pool->memory_pool + new_block->offset;
+    }
+    if (!new_ptr) {
+        pool->stats.failed_allocs++;
+        return NULL;
+    }
+
+    // Step 7: Copy data to new block and free the old one
+    memcpy(new_ptr, ptr, curr->size);
+    block_free(pool, curr);
+    pool->stats.resizes_moved++;
+    *how = MEM_RESIZE_MOVED;
+    return new_ptr;
+}
+
+// Allocate a block of memory from a pool
+static void* pool_alloc(mem_pool_t* pool, size_t size) {
+    if (!pool) return NULL;
+
     // Step 1: If size is 0, return the first free block
     if (size == 0) {
-        for (MemBlock* curr = block_list; curr; curr = curr->next) {
-            if (curr->is_free) {
-                return memory_pool + curr->offset;
-            }
+        pthread_mutex_lock(&pool->lock);
+        int cls = find_free_class(pool, 0);
+        void* first = cls >= 0 ? pool->memory_pool + pool->free_lists[cls]->offset : NULL;
+        pthread_mutex_unlock(&pool->lock);
+        return first;
+    }
+
+    // Step 2: Requests of at least mmap_threshold bytes get a mapping of their own
+    if (pool->mmap_threshold && size >= pool->mmap_threshold) {
+        LargeBlock* large = large_map(pool, size);
+        pthread_mutex_lock(&pool->lock);
+        if (large) {
+            large_link(pool, large);
+            pool->stats.allocs++;
+        } else {
+            pool->stats.failed_allocs++;
         }
-        return NULL;
+        pthread_mutex_unlock(&pool->lock);
+        return large ? (char*)large + LARGE_HEADER : NULL;
     }
 
-    // Step 2: Find a free block that's big enough
-    for (MemBlock* curr = block_list; curr; curr = curr->next) {
-        if (curr->is_free && curr->size >= size) {
-
-            // Step 3: If the block is larger than needed, split it
-            if (curr->size > size) {
-                MemBlock* new_block = malloc(sizeof(MemBlock));
-                new_block->offset = curr->offset + size;
-                new_block->size = curr->size - size;
-                new_block->is_free = 1;
-                new_block->next = curr->next;
-
-                curr->size = size;
-                curr->is_free = 0;
-                curr->next = new_block;
-            } else {
-                // Step 4: If the size matches exactly, mark it as used/allocated
-                curr->is_free = 0;
-            }
-
-            // Step 5: Return a pointer to the memory block
-            return memory_pool + curr->offset;
+    // Step 3: Small requests are served from this thread's cache without taking the lock
+    // (every small request is rounded up to a bin size, so any cached block fits)
+    ThreadCache* tc = size <= TCACHE_MAX && pool->tcache ? tcache_get(pool) : NULL;
+    if (tc) {
+        int bin = (int)((size - 1) / TCACHE_STEP);
+        if (tc->counts[bin] == 0) tcache_refill(tc, bin);
+        if (tc->counts[bin] > 0) {
+            MemBlock* block = tc->bins[bin][--tc->counts[bin]];
+            __atomic_store_n(&block->in_cache, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&tc->allocs, tc->allocs + 1, __ATOMIC_RELAXED);
+            return pool->memory_pool + block->offset;
         }
     }
 
-    // Step 6: No suitable block was found
-    return NULL;
+    // Step 4: Take a block from the shared pool
+    pthread_mutex_lock(&pool->lock);
+    MemBlock* curr = block_alloc(pool, size);
+
+    // Step 5: If nothing fits, give back what this thread has cached and try again
+    if (!curr && pool->tcache && (tc = pthread_getspecific(pool->tcache_key))) {
+        tcache_flush(tc);
+        curr = block_alloc(pool, size);
+    }
+    if (curr) pool->stats.allocs++;
+    else pool->stats.failed_allocs++;
+    pthread_mutex_unlock(&pool->lock);
+
+    // Step 6: Return a pointer to the memory block (NULL if no suitable block was found)
+    return curr ? pool->memory_pool + curr->offset : NULL;
 }
 
-// Free a previously allocated memory block
-void mem_free(void* ptr) {
-    // Step 1: If the pointer is NULL, do nothing
-    if (!ptr) return;
-
-    // Step 2: Find where in the memory pool the pointer points to (Calculate offset)
-    size_t offset = (char*)ptr - memory_pool;
-    MemBlock* prev = NULL;
-
-    // Step 3: Find the memory block that matches this offset
-    for (MemBlock* curr = block_list; curr; curr = curr->next) {
-        if (curr->offset == offset) {
-
-            // Step 4: If it's already free, do nothing
-            if (curr->is_free) return;
-
-            // Step 5: Mark the block as free
-            curr->is_free = 1;
-
-            // Step 6: Merge with next block if it's free
-            if (curr->next && curr->next->is_free) {
-                MemBlock* next_block = curr->next;
-                curr->size += next_block->size;
-                curr->next = next_block->next;
-                free(next_block);
-            }
-
-            // Step 7: Merge with previous block if it's free
-            if (prev && prev->is_free) {
-                prev->size += curr->size;
-                prev->next = curr->next;
-                free(curr);
-            }
+// Free a block previously allocated from a pool
+static void pool_free(mem_pool_t* pool, void* ptr) {
+    // Step 1: If the pointer is NULL or not from the pool, do nothing; large blocks are unmapped
+    if (!pool || !ptr) return;
+    if (!in_pool(pool, ptr)) {
+        LargeBlock* large = large_block(pool, ptr);
+        if (large) large_free(pool, large);
+        return;
+    }
 
+    // Step 2: Small blocks go to this thread's cache without taking the lock
+    MemBlock* curr = pool->tcache ? index_lookup_unlocked(pool, (char*)ptr - pool->memory_pool) : NULL;
+    size_t size = curr ? __atomic_load_n(&curr->size, __ATOMIC_RELAXED) : 0;
+    if (curr && size <= TCACHE_MAX && size % TCACHE_STEP == 0) {
+        if (__atomic_load_n(&curr->in_cache, __ATOMIC_RELAXED)) return; // Already freed
+
+        ThreadCache* tc = tcache_get(pool);
+        if (tc) {
+            int bin = (int)(size / TCACHE_STEP) - 1;
+            if (tc->counts[bin] == TCACHE_COUNT) tcache_spill(tc, bin);
+            __atomic_store_n(&curr->in_cache, 1, __ATOMIC_RELAXED);
+            tc->bins[bin][tc->counts[bin]++] = curr;
+            __atomic_store_n(&tc->frees, tc->frees + 1, __ATOMIC_RELAXED);
             return;
         }
+    }
 
-        // Step 8: Save the current block as the previous for next loop
-        prev = curr;
+    // Step 3: Look the block up in the offset index; if it isn't allocated, do nothing
+    pthread_mutex_lock(&pool->lock);
+    curr = find_block(pool, ptr);
+    if (curr && !curr->in_cache) {
+        block_free(pool, curr);
+        pool->stats.frees++;
     }
+    pthread_mutex_unlock(&pool->lock);
 }
 
-// Resize an existing memory block
-void* mem_resize(void* ptr, size_t size) {
+// Resize a block previously allocated from a pool, reporting how
+static void* pool_resize(mem_pool_t* pool, void* ptr, size_t size, enum mem_resize_how* how) {
     // Step 1: If the pointer is NULL, allocate a new block
-    if (!ptr) return mem_alloc(size);
+    if (!ptr) {
+        void* new_ptr = pool_alloc(pool, size);
+        *how = new_ptr ? MEM_RESIZE_MOVED : MEM_RESIZE_FAILED;
+        return new_ptr;
+    }
 
     // Step 2: If the size is 0, free the memory and return NULL
+    *how = MEM_RESIZE_FAILED;
     if (size == 0) {
-        mem_free(ptr);
+        pool_free(pool, ptr);
         return NULL;
     }
+    if (!pool) return NULL;
+
+    // Step 3: A large block that grows or is still large enough is remapped. Only one that
+    // shrinks moves into the pool, as mmap_threshold may have changed since it was mapped.
+    LargeBlock* large = in_pool(pool, ptr) ? NULL : large_block(pool, ptr);
+    int grows = large && size > large->length - LARGE_HEADER;
+    if (large && (grows || (size >= pool->mmap_threshold && pool->mmap_threshold))) {
+        return large_resize(pool, large, size, how);
+    }
+
+    // Step 4: Grow or shrink the block in place, or move it
+    pthread_mutex_lock(&pool->lock);
+    void* result = large ? large_shrink(pool, large, size, how) : resize_locked(pool, ptr, size, how);
+    pthread_mutex_unlock(&pool->lock);
+    return result;
+}
+
+// Allocate a block from a pool whose address is a multiple of align
+static void* pool_alloc_aligned(mem_pool_t* pool, size_t size, size_t align) {
+    // Step 1: align must be a power of two; MEM_ALIGN is what every block gets anyway
+    if (!pool || align == 0 || (align & (align - 1))) return NULL;
+    if (align <= MEM_ALIGN) return pool_alloc(pool, size);
+
+    // Step 2: Take a suitably placed block from the shared pool
+    pthread_mutex_lock(&pool->lock);
+    MemBlock* curr = block_alloc_aligned(pool, size ? size : 1, align);
+
+    // Step 3: If nothing fits, give back what this thread has cached and try again
+    ThreadCache* tc;
+    if (!curr && pool->tcache && (tc = pthread_getspecific(pool->tcache_key))) {
+        tcache_flush(tc);
+        curr = block_alloc_aligned(pool, size ? size : 1, align);
+    }
+    if (curr) pool->stats.allocs++;
+    else pool->stats.failed_allocs++;
+    pthread_mutex_unlock(&pool->lock);
+
+    return curr ? pool->memory_pool + curr->offset : NULL;
+}
+
+#ifdef MEM_TRACE
+// Latency histogram buckets: values below TRACE_SUB get one bucket each, above that every
+// power of two is split into TRACE_SUB buckets, so a bucket is at most 1/8 wide
+#define TRACE_SUB_BITS 3
+#define TRACE_SUB (1 << TRACE_SUB_BITS)
+#define TRACE_BUCKETS ((64 - TRACE_SUB_BITS + 1) * TRACE_SUB)
+
+// One thread's latencies. Only the owner writes it, so recording takes no lock
+// and no atomic read-modify-write; readers add up every thread's counts.
+typedef struct TraceHist {
+    uint64_t counts[MEM_OP_COUNT][TRACE_BUCKETS];
+    uint64_t max[MEM_OP_COUNT];
+    struct TraceHist* next;     // All live threads' histograms
+    struct TraceHist* prev;
+} TraceHist;
+
+static pthread_once_t trace_once = PTHREAD_ONCE_INIT;
+static pthread_key_t trace_key;                        // Each thread's TraceHist
+static pthread_mutex_t trace_lock = PTHREAD_MUTEX_INITIALIZER; // Guards the two below
+static TraceHist* trace_threads;                       // Histograms of live threads
+static TraceHist trace_retired;                        // Counts of threads that have exited
+
+static mem_hook_t trace_hook;                          // Called after every operation
+static void* trace_hook_arg;
+static pthread_key_t trace_busy_key;                   // Set while this thread runs the hook
+
+// Histogram bucket for a latency in nanoseconds
+static size_t trace_bucket(uint64_t ns) {
+    if (ns < TRACE_SUB) return ns;
+
+    int fl = 63 - __builtin_clzll(ns);
+    return (size_t)(fl - TRACE_SUB_BITS + 1) * TRACE_SUB + ((ns >> (fl - TRACE_SUB_BITS)) - TRACE_SUB);
+}
+
+// Largest latency that falls into a bucket
+static uint64_t trace_bucket_max(size_t bucket) {
+    if (bucket < TRACE_SUB) return bucket;
+
+    int shift = (int)(bucket / TRACE_SUB) - 1;
+    uint64_t low = (uint64_t)(TRACE_SUB + bucket % TRACE_SUB) << shift;
+    return low + ((uint64_t)1 << shift) - 1;
+}
+
+// Thread exit: keep the thread's counts and drop its histogram
+static void trace_release(void* arg) {
+    TraceHist* hist = arg;
+
+    pthread_mutex_lock(&trace_lock);
+    for (int op = 0; op < MEM_OP_COUNT; op++) {
+        for (size_t b = 0; b < TRACE_BUCKETS; b++) trace_retired.counts[op][b] += hist->counts[op][b];
+        if (hist->max[op] > trace_retired.max[op]) trace_retired.max[op] = hist->max[op];
+    }
+    if (hist->prev) hist->prev->next = hist->next;
+    else trace_threads = hist->next;
+    if (hist->next) hist->next->prev = hist->prev;
+    pthread_mutex_unlock(&trace_lock);
+
+    free(hist);
+}
+
+static void trace_init(void) {
+    pthread_key_create(&trace_key, trace_release);
+    pthread_key_create(&trace_busy_key, NULL);
+}
+
+// Current time in nanoseconds
+static uint64_t trace_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// Record how long an operation took in the calling thread's histogram and report it to the hook
+static void trace_record(enum mem_op op, uint64_t start, mem_pool_t* pool, void* old_ptr, void* new_ptr, size_t size) {
+    uint64_t ns = trace_now() - start;
+
+    // Step 1: Find this thread's histogram, created on first use
+    pthread_once(&trace_once, trace_init);
+    TraceHist* hist = pthread_getspecific(trace_key);
+    if (!hist && (hist = calloc(1, sizeof(TraceHist)))) {
+        pthread_mutex_lock(&trace_lock);
+        hist->next = trace_threads;
+        if (trace_threads) trace_threads->prev = hist;
+        trace_threads = hist;
+        pthread_mutex_unlock(&trace_lock);
+        pthread_setspecific(trace_key, hist);
+    }
+
+    // Step 2: Count the latency
+    if (hist) {
+        uint64_t* count = &hist->counts[op][trace_bucket(ns)];
+        __atomic_store_n(count, *count + 1, __ATOMIC_RELAXED);
+        if (ns > hist->max[op]) __atomic_store_n(&hist->max[op], ns, __ATOMIC_RELAXED);
+    }
+
+    // Step 3: Call the hook, unless this call came from the hook itself
+    mem_hook_t hook = __atomic_load_n(&trace_hook, __ATOMIC_ACQUIRE);
+    if (hook && !pthread_getspecific(trace_busy_key)) {
+        pthread_setspecific(trace_busy_key, &trace_busy_key);
+        hook(pool, op, old_ptr, new_ptr, size, trace_hook_arg);
+        pthread_setspecific(trace_busy_key, NULL);
+    }
+}
+
+// Time an operation; compiles to the plain call without MEM_TRACE
+#define TRACE_BEGIN() uint64_t trace_start = trace_now()
+#define TRACE_END(op, pool, old_ptr, new_ptr, size) trace_record(op, trace_start, pool, old_ptr, new_ptr, size)
+#else
+#define TRACE_BEGIN()
+#define TRACE_END(op, pool, old_ptr, new_ptr, size)
+#endif
+
+// Allocate a block of memory from a pool
+void* mem_pool_alloc(mem_pool_t* pool, size_t size) {
+    TRACE_BEGIN();
+    void* ptr = pool_alloc(pool, size);
+    TRACE_END(MEM_OP_ALLOC, pool, NULL, ptr, size);
+    return ptr;
+}
+
+// Free a block previously allocated from a pool
+void mem_pool_free(mem_pool_t* pool, void* ptr) {
+    TRACE_BEGIN();
+    pool_free(pool, ptr);
+    TRACE_END(MEM_OP_FREE, pool, ptr, NULL, 0);
+}
+
+// Resize a block previously allocated from a pool
+void* mem_pool_resize(mem_pool_t* pool, void* ptr, size_t size) {
+    enum mem_resize_how how;
+    return mem_pool_resize_ex(pool, ptr, size, &how);
+}
+
+// Resize a block previously allocated from a pool and report how it got its new size
+void* mem_pool_resize_ex(mem_pool_t* pool, void* ptr, size_t size, enum mem_resize_how* how) {
+    enum mem_resize_how ignored;
+    if (!how) how = &ignored;
+
+    TRACE_BEGIN();
+    void* new_ptr = pool_resize(pool, ptr, size, how);
+    TRACE_END(MEM_OP_RESIZE, pool, ptr, new_ptr, size);
+    return new_ptr;
+}
+
+// Allocate a block from a pool whose address is a multiple of align
+void* mem_pool_alloc_aligned(mem_pool_t* pool, size_t size, size_t align) {
+    TRACE_BEGIN();
+    void* ptr = pool_alloc_aligned(pool, size, align);
+    TRACE_END(MEM_OP_ALLOC, pool, NULL, ptr, size);
+    return ptr;
+}
+
+// Install the hook called after every alloc, free and resize (NULL removes it)
+int mem_set_hook(mem_hook_t hook, void* arg) {
+#ifdef MEM_TRACE
+    trace_hook_arg = arg;
+    __atomic_store_n(&trace_hook, hook, __ATOMIC_RELEASE);
+    return 1;
+#else
+    (void)hook;
+    (void)arg;
+    return 0;
+#endif
+}
+
+// Latency percentiles of one kind of operation, over every thread
+int mem_latency(enum mem_op op, struct mem_latency* latency) {
+    if (!latency) return 0;
+    memset(latency, 0, sizeof(*latency));
+#ifdef MEM_TRACE
+    if ((int)op < 0 || op >= MEM_OP_COUNT) return 0;
+
+    // Step 1: Add up the histograms of the live threads and the ones that have exited
+    uint64_t counts[TRACE_BUCKETS];
+    uint64_t total = 0;
+    pthread_mutex_lock(&trace_lock);
+    for (size_t b = 0; b < TRACE_BUCKETS; b++) counts[b] = trace_retired.counts[op][b];
+    latency->max_ns = trace_retired.max[op];
+    for (TraceHist* hist = trace_threads; hist; hist = hist->next) {
+        for (size_t b = 0; b < TRACE_BUCKETS; b++) counts[b] += __atomic_load_n(&hist->counts[op][b], __ATOMIC_RELAXED);
+        uint64_t max = __atomic_load_n(&hist->max[op], __ATOMIC_RELAXED);
+        if (max > latency->max_ns) latency->max_ns = max;
+    }
+    for (size_t b = 0; b < TRACE_BUCKETS; b++) total += counts[b];
 
-    // Step 3: Calculate the offset in memory
-    size_t offset = (char*)ptr - memory_pool;
-
-    // Step 4: Find the block that starts at this offset
-    for (MemBlock* curr = block_list; curr; curr = curr->next) {
-        if (curr->offset == offset) {
-
-            // Step 5: If current block is big enough, try shrink it
-            if (curr->size >= size) {
-                if (curr->size > size) {
-                    MemBlock* new_block = malloc(sizeof(MemBlock));
-                    if (!new_block) return NULL;
-
-                    new_block->offset = curr->offset + size;
-                    new_block->size = curr->size - size;
-                    new_block->is_free = 1;
-                    new_block->next = curr->next;
-
-                    curr->size = size;
-                    curr->next = new_block;
-                }
-                return ptr;
-            } else {
-                // Step 6: Check if the next block is free and we can join it with this one to make enough space
-                if (curr->next && curr->next->is_free &&
-                    (curr->size + curr->next->size) >= size) {
-
-                    curr->size += curr->next->size;
-                    MemBlock* next_block = curr->next;
-                    curr->next = next_block->next;
-                    free(next_block);
-
-                    // Step 7: After merging; if we now have more space than we need, split off the extra into a new free block
-                    if (curr->size > size) {
-                        MemBlock* new_block = malloc(sizeof(MemBlock));
-                        if (!new_block) return NULL;
-
-                        new_block->offset = curr->offset + size;
-                        new_block->size = curr->size - size;
-                        new_block->is_free = 1;
-                        new_block->next = curr->next;
-
-                        curr->size = size;
-                        curr->next = new_block;
-                    }
-
-                    return ptr;
-                } else {
-                    // Step 8: If we still doesnt fit in place, try to allocate to a new bigger block somewhere else
-                    void* new_ptr = mem_alloc(size);
-                    if (new_ptr) {
-                        // Step 9: Copy data to new block and free the old one
-                        memcpy(new_ptr, ptr, curr->size);
-                        mem_free(ptr);
-                    }
-                    return new_ptr;
-                }
-            }
+    // Step 2: Walk up the buckets to each percentile; a bucket reports its upper bound
+    size_t* targets[] = {&latency->p50_ns, &latency->p99_ns, &latency->p999_ns};
+    uint64_t ranks[] = {(total + 1) / 2, total - total / 100, total - total / 1000};
+    uint64_t seen = 0;
+    int next = 0;
+    for (size_t b = 0; b < TRACE_BUCKETS && next < 3 && total; b++) {
+        seen += counts[b];
+        while (next < 3 && seen >= ranks[next]) {
+            uint64_t ns = trace_bucket_max(b);
+            *targets[next++] = ns < latency->max_ns ? ns : latency->max_ns;
         }
     }
-    // Step 10: If no block was found, return NULL
-    return NULL;
+    pthread_mutex_unlock(&trace_lock);
+    latency->count = total;
+    return 1;
+#else
+    (void)op;
+    return 0;
+#endif
 }
 
-// Shut down the memory system and free everything
-void mem_deinit() {
-    // Step 1: Free the memory pool
-    if (memory_pool) {
-        free(memory_pool);
-        memory_pool = NULL;
-        pool_size = 0;
+// Start the latency histograms over
+void mem_latency_reset(void) {
+#ifdef MEM_TRACE
+    pthread_mutex_lock(&trace_lock);
+    memset(trace_retired.counts, 0, sizeof(trace_retired.counts));
+    memset(trace_retired.max, 0, sizeof(trace_retired.max));
+    for (TraceHist* hist = trace_threads; hist; hist = hist->next) {
+        memset(hist->counts, 0, sizeof(hist->counts));
+        memset(hist->max, 0, sizeof(hist->max));
+    }
+    pthread_mutex_unlock(&trace_lock);
+#endif
+}
+
+// Before fork(): take the pool's lock (and the trace lock), so that no other thread
+// holds them while the process is copied
+void mem_pool_fork_prepare(mem_pool_t* pool) {
+    if (pool) pthread_mutex_lock(&pool->lock);
+#ifdef MEM_TRACE
+    pthread_mutex_lock(&trace_lock);
+#endif
+}
+
+// After fork(), in the parent: release what mem_pool_fork_prepare took
+void mem_pool_fork_parent(mem_pool_t* pool) {
+#ifdef MEM_TRACE
+    pthread_mutex_unlock(&trace_lock);
+#endif
+    if (pool) pthread_mutex_unlock(&pool->lock);
+}
+
+// After fork(), in the child: start over with fresh locks. A shared pool's lock is the
+// parent's as well, and the parent releases it.
+void mem_pool_fork_child(mem_pool_t* pool) {
+#ifdef MEM_TRACE
+    pthread_mutex_init(&trace_lock, NULL);
+#endif
+    if (pool && !pool->shared) pthread_mutex_init(&pool->lock, NULL);
+}
+
+// Serve requests of at least threshold bytes from mappings of their own (0 turns it off).
+// A shared pool can't: its other processes wouldn't see the mappings.
+int mem_pool_set_mmap_threshold(mem_pool_t* pool, size_t threshold) {
+    if (!pool || pool->shared) return 0;
+
+    pthread_mutex_lock(&pool->lock);
+    pool->mmap_threshold = threshold;
+    pthread_mutex_unlock(&pool->lock);
+    return 1;
+}
+
+// Check whether a pointer is a pool's: in its memory or one of its large blocks
+int mem_pool_owns(mem_pool_t* pool, const void* ptr) {
+    return pool && (in_pool(pool, (void*)ptr) || large_block(pool, (void*)ptr));
+}
+
+// Bytes usable in an allocated block (0 if ptr isn't one)
+size_t mem_pool_block_size(mem_pool_t* pool, void* ptr) {
+    if (!pool) return 0;
+    if (!in_pool(pool, ptr)) {
+        LargeBlock* large = large_block(pool, ptr);
+        return large ? large->length - LARGE_HEADER : 0;
+    }
+
+    pthread_mutex_lock(&pool->lock);
+    MemBlock* curr = find_block(pool, ptr);
+    size_t size = curr && !curr->in_cache ? curr->size : 0;
+    pthread_mutex_unlock(&pool->lock);
+    return size;
+}
+
+// Size of the largest free block: it sits in the highest non-empty size class
+static size_t largest_free_block(mem_pool_t* pool) {
+    for (int w = BITMAP_WORDS - 1; w >= 0; w--) {
+        uint64_t bits = pool->free_bitmap[w];
+        if (!bits) continue;
+
+        size_t largest = 0;
+        for (MemBlock* curr = pool->free_lists[w * 64 + 63 - __builtin_clzll(bits)]; curr; curr = curr->next_free) {
+            if (curr->size > largest) largest = curr->size;
+        }
+        return largest;
+    }
+    return 0;
+}
+
+// Fill in a snapshot of a pool from its running counts
+void mem_pool_stats(mem_pool_t* pool, struct mem_stats* stats) {
+    if (!stats) return;
+    memset(stats, 0, sizeof(*stats));
+    if (!pool) return;
+
+    // Step 1: Copy the counts, adding what the thread caches counted on their own
+    pthread_mutex_lock(&pool->lock);
+    *stats = pool->stats;
+    for (ThreadCache* tc = pool->tcache_list; tc; tc = tc->next) {
+        stats->allocs += __atomic_load_n(&tc->allocs, __ATOMIC_RELAXED);
+        stats->frees += __atomic_load_n(&tc->frees, __ATOMIC_RELAXED);
+    }
+    stats->pool_size = pool->pool_size;
+    stats->largest_free = largest_free_block(pool);
+    pthread_mutex_unlock(&pool->lock);
+
+    // Step 2: Work out the rest
+    stats->live_blocks = stats->allocs - stats->frees;
+    stats->used_bytes = stats->pool_size - stats->free_bytes;
+    stats->fragmentation = stats->free_bytes ? 1.0 - (double)stats->largest_free / stats->free_bytes : 0.0;
+}
+
+// Bump-pointer arena living in a block of a pool; this header sits at the block start
+struct mem_arena {
+    mem_pool_t* pool;                      // The pool the arena's block came from
+    char* base;                            // First byte handed out by the arena
+    size_t size;                           // Bytes available from base
+    size_t top;                            // Bytes handed out so far
+};
+
+// Carve an arena of size usable bytes out of a pool
+mem_arena_t* mem_pool_arena_create(mem_pool_t* pool, size_t size) {
+    // Step 1: One block holds the arena header followed by its memory
+    size_t header = align_size(sizeof(mem_arena_t));
+    if (size > SIZE_MAX - header) return NULL;
+    mem_arena_t* arena = mem_pool_alloc(pool, header + size);
+    if (!arena) return NULL;
+
+    // Step 2: Start out empty
+    arena->pool = pool;
+    arena->base = (char*)arena + header;
+    arena->size = size;
+    arena->top = 0;
+    return arena;
+}
+
+// Hand out size bytes from the arena by moving its top up
+void* mem_arena_alloc(mem_arena_t* arena, size_t size) {
+    size_t aligned = align_size(size ? size : 1);
+    if (!arena || !aligned || aligned > arena->size - arena->top) return NULL;
+
+    void* ptr = arena->base + arena->top;
+    arena->top += aligned;
+    return ptr;
+}
+
+// Current top of the arena, to be passed to mem_arena_reset later
+size_t mem_arena_mark(mem_arena_t* arena) {
+    return arena ? arena->top : 0;
+}
+
+// Release everything allocated since mark in one step
+void mem_arena_reset(mem_arena_t* arena, size_t mark) {
+    if (arena && mark <= arena->top) arena->top = mark;
+}
+
+// Give the arena's block back to its pool
+void mem_arena_destroy(mem_arena_t* arena) {
+    if (arena) mem_pool_free(arena->pool, arena);
+}
+
+// Fixed-size object slab living in a block of a pool; this header sits at the block start
+struct mem_slab {
+    mem_pool_t* pool;                      // The pool the slab's block came from
+    char* base;                            // First object slot
+    size_t obj_size;                       // Slot size, rounded up to MEM_ALIGN
+    size_t count;                          // Number of slots
+    void* free_list;                       // Free slots, each holding a pointer to the next
+};
+
+// Slot size of a slab: every slot must be able to hold the free list link and stay aligned
+static size_t slab_slot_size(size_t obj_size) {
+    return align_size(obj_size < sizeof(void*) ? sizeof(void*) : obj_size);
+}
+
+// Bytes of pool memory a slab of count objects of obj_size bytes takes (0 if that overflows)
+size_t mem_slab_size(size_t obj_size, size_t count) {
+    size_t header = align_size(sizeof(mem_slab_t));
+    obj_size = slab_slot_size(obj_size);
+    if (!obj_size || !count || count > (SIZE_MAX - header) / obj_size) return 0;
+    return header + obj_size * count;
+}
+
+// Carve a slab of count objects of obj_size bytes out of a pool
+mem_slab_t* mem_pool_slab_create(mem_pool_t* pool, size_t obj_size, size_t count) {
+    // Step 1: Work out the slot size and the block size
+    size_t size = mem_slab_size(obj_size, count);
+    if (!size) return NULL;
+    obj_size = slab_slot_size(obj_size);
+
+    // Step 2: One block holds the slab header followed by all slots
+    mem_slab_t* slab = mem_pool_alloc(pool, size);
+    if (!slab) return NULL;
+    slab->pool = pool;
+    slab->base = (char*)slab + align_size(sizeof(mem_slab_t));
+    slab->obj_size = obj_size;
+    slab->count = count;
+
+    // Step 3: Thread every slot onto the free list, lowest address first
+    slab->free_list = NULL;
+    for (size_t i = count; i > 0; i--) {
+        void* slot = slab->base + (i - 1) * obj_size;
+        *(void**)slot = slab->free_list;
+        slab->free_list = slot;
+    }
+    return slab;
+}
+
+// Take one object from the slab (NULL if every slot is in use)
+void* mem_slab_alloc(mem_slab_t* slab) {
+    if (!slab || !slab->free_list) return NULL;
+
+    void* slot = slab->free_list;
+    slab->free_list = *(void**)slot;
+    return slot;
+}
+
+// Put an object back on the slab's free list
+void mem_slab_free(mem_slab_t* slab, void* ptr) {
+    // Step 1: Ignore pointers that are not the start of one of this slab's slots
+    if (!slab || (char*)ptr < slab->base) return;
+    size_t offset = (char*)ptr - slab->base;
+    if (offset >= slab->obj_size * slab->count || offset % slab->obj_size) return;
+
+    // Step 2: The slot itself becomes the free list link
+    *(void**)ptr = slab->free_list;
+    slab->free_list = ptr;
+}
+
+// First slot of the slab
+void* mem_slab_objects(mem_slab_t* slab) {
+    return slab ? slab->base : NULL;
+}
+
+// Give the slab's block back to its pool
+void mem_slab_destroy(mem_slab_t* slab) {
+    if (slab) mem_pool_free(slab->pool, slab);
+}
+
+// Destroy a pool and everything allocated from it
+void mem_pool_destroy(mem_pool_t* pool) {
+    if (!pool) return;
+
+    // Step 1: Drop every thread's cache; their blocks go away with the pool
+    if (pool->tcache) pthread_key_delete(pool->tcache_key);
+    while (pool->tcache_list) {
+        ThreadCache* next = pool->tcache_list->next;
+        free(pool->tcache_list);
+        pool->tcache_list = next;
+    }
+
+    // Step 2: Unmap the large blocks, then release the offset index and the tables it replaced
+    while (pool->large_blocks) {
+        LargeBlock* next = pool->large_blocks->next;
+        munmap(pool->large_blocks, pool->large_blocks->length);
+        pool->large_blocks = next;
     }
+    BlockIndex* index = pool->block_index;
+    while (index && !pool->fixed_metadata) {
+        BlockIndex* retired = index->retired;
+        free(index);
+        index = retired;
+    }
+
+    // Step 3: Free the node chunks added after creation
+    while (pool->node_chunks) {
+        NodeChunk* next = pool->node_chunks->next;
+        free(pool->node_chunks);
+        pool->node_chunks = next;
+    }
+
+    // Step 4: Free the memory pool together with its metadata (this struct included).
+    // A shared pool is only unmapped; the lock lives on for the other processes.
+    if (!pool->shared) pthread_mutex_destroy(&pool->lock);
+    if (pool->mapped_size) {
+        munmap(pool->memory_pool, pool->mapped_size);
+    } else {
+        free(pool->memory_pool);
+    }
+}
+
+// Initialize the memory system
+void mem_init(size_t size) {
+    default_pool = mem_pool_create(size);
+    if (!default_pool) {
+        fprintf(stderr, "Error: Could not allocate memory pool\n");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    // Step 2: Free all the block metadata
-    MemBlock* curr = block_list;
-    while (curr) {
-        MemBlock* next = curr->next;
-        free(curr);
-        curr = next;
+// Initialize the memory system with all block metadata reserved up front
+void mem_init_fixed(size_t size, size_t max_blocks) {
+    default_pool = mem_pool_create_fixed(size, max_blocks);
+    if (!default_pool) {
+        fprintf(stderr, "Error: Could not allocate memory pool\n");
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Initialize the memory system with a pool reserved by mmap
+void mem_init_mapped(size_t size, unsigned flags) {
+    default_pool = mem_pool_create_mapped(size, flags);
+    if (!default_pool) {
+        fprintf(stderr, "Error: Could not allocate memory pool\n");
+        exit(EXIT_FAILURE);
     }
+}
+
+// Initialize the memory system with a pool that grows on demand
+void mem_init_growable(size_t size, size_t max_size, unsigned flags) {
+    default_pool = mem_pool_create_growable(size, max_size, flags);
+    if (!default_pool) {
+        fprintf(stderr, "Error: Could not allocate memory pool\n");
+        exit(EXIT_FAILURE);
+    }
+}
 
-    // Step 3: Clear the block list pointer
-    block_list = NULL;
+// Allocate a block of memory
+void* mem_alloc(size_t size) {
+    return mem_pool_alloc(default_pool, size);
+}
+
+// Free a previously allocated memory block
+void mem_free(void* ptr) {
+    mem_pool_free(default_pool, ptr);
+}
+
+// Resize an existing memory block
+void* mem_resize(void* ptr, size_t size) {
+    return mem_pool_resize(default_pool, ptr, size);
+}
+
+// Resize an existing memory block and report how it got its new size
+void* mem_resize_ex(void* ptr, size_t size, enum mem_resize_how* how) {
+    return mem_pool_resize_ex(default_pool, ptr, size, how);
+}
+
+// Allocate a block of memory whose address is a multiple of align
+void* mem_alloc_aligned(size_t size, size_t align) {
+    return mem_pool_alloc_aligned(default_pool, size, align);
+}
+
+// Carve an arena out of the memory system's pool
+mem_arena_t* mem_arena_create(size_t size) {
+    return mem_pool_arena_create(default_pool, size);
+}
+
+// Carve a slab of fixed-size objects out of the memory system's pool
+mem_slab_t* mem_slab_create(size_t obj_size, size_t count) {
+    return mem_pool_slab_create(default_pool, obj_size, count);
+}
+
+// Take a snapshot of the memory system's pool
+void mem_stats(struct mem_stats* stats) {
+    mem_pool_stats(default_pool, stats);
+}
+
+// Serve large requests to the memory system from mappings of their own
+int mem_set_mmap_threshold(size_t threshold) {
+    return mem_pool_set_mmap_threshold(default_pool, threshold);
+}
+
+// Shut down the memory system and free everything
+void mem_deinit() {
+    mem_pool_destroy(default_pool);
+    default_pool = NULL;
 }
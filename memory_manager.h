@@ -2,10 +2,35 @@
 #define MEMORY_MANAGER_H
 
 #include <stdlib.h>
+#include <stddef.h>
+
+// Every block handed out is aligned to at least this many bytes
+#define MEM_ALIGN _Alignof(max_align_t)
 
 // Initialize memory manager with given pool size
 void mem_init(size_t size);
 
+// Initialize memory manager with metadata for at most max_blocks blocks
+// reserved up front, so no system allocations happen after this call
+void mem_init_fixed(size_t size, size_t max_blocks);
+
+// Options for pools reserved with mmap (mem_init_mapped, mem_pool_create_mapped)
+#define MEM_MAP_HUGEPAGES 1   // Back the pool with transparent huge pages where possible
+#define MEM_MAP_RELEASE 2     // Give the pages of large free ranges back to the OS
+
+// Initialize memory manager with a pool reserved by mmap: memory is only
+// committed when it is first used, so a large pool costs little up front
+void mem_init_mapped(size_t size, unsigned flags);
+
+// Initialize memory manager with a pool that starts at size bytes and, when
+// nothing fits, grows by at least doubling up to max_size. The address range
+// for max_size is reserved up front, so blocks never move when it grows.
+// flags are the MEM_MAP_* options.
+void mem_init_growable(size_t size, size_t max_size, unsigned flags);
+
+// Serve large requests from mmap regions of their own (see mem_pool_set_mmap_threshold)
+int mem_set_mmap_threshold(size_t threshold);
+
 // Allocate memory block of given size
 void* mem_alloc(size_t size);
 
@@ -15,7 +40,199 @@ void mem_free(void* block);
 // Resize previously allocated memory block
 void* mem_resize(void* block, size_t size);
 
+// How a resize got a block to its new size
+enum mem_resize_how {
+    MEM_RESIZE_FAILED,       // NULL was returned (also when size 0 freed the block)
+    MEM_RESIZE_IN_PLACE,     // The block stayed where it was
+    MEM_RESIZE_SHIFTED,      // It took in the free block in front; the data was moved down with memmove
+    MEM_RESIZE_MOVED,        // It was copied to a new block
+    MEM_RESIZE_REMAPPED      // A large block was moved by mremap, without copying
+};
+
+// Resize previously allocated memory block and report how in *how (may be NULL).
+// A growing block gets some headroom, up to the next size class, so that
+// repeated growth is mostly done in place.
+void* mem_resize_ex(void* block, size_t size, enum mem_resize_how* how);
+
+// Allocate memory block of given size at an address that is a multiple of
+// align (a power of two), e.g. 64 for a cache line or 4096 for a page
+void* mem_alloc_aligned(size_t size, size_t align);
+
 // Deinitialize memory manager and free all resources
 void mem_deinit();
 
+// Independent pool; the mem_* functions above work on a default pool
+typedef struct mem_pool mem_pool_t;
+
+// Create a pool of given size (NULL if it can't be allocated)
+mem_pool_t* mem_pool_create(size_t size);
+
+// Create a pool with metadata for at most max_blocks blocks reserved up front
+mem_pool_t* mem_pool_create_fixed(size_t size, size_t max_blocks);
+
+// Create a pool reserved by mmap and committed as it is used (see mem_init_mapped)
+mem_pool_t* mem_pool_create_mapped(size_t size, unsigned flags);
+
+// Create a pool that grows on demand (see mem_init_growable)
+mem_pool_t* mem_pool_create_growable(size_t size, size_t max_size, unsigned flags);
+
+// Create a pool that processes forked after this call share. Pool memory and
+// metadata for at most max_blocks blocks live in one MAP_SHARED mapping behind a
+// process-shared lock; small blocks are not cached per thread. Each process
+// calls mem_pool_destroy when it is done with the pool.
+mem_pool_t* mem_pool_create_shared(size_t size, size_t max_blocks);
+
+// Allocate memory block of given size from a pool
+void* mem_pool_alloc(mem_pool_t* pool, size_t size);
+
+// Free memory block previously allocated from a pool
+void mem_pool_free(mem_pool_t* pool, void* block);
+
+// Resize memory block previously allocated from a pool
+void* mem_pool_resize(mem_pool_t* pool, void* block, size_t size);
+
+// Resize memory block previously allocated from a pool and report how (see mem_resize_ex)
+void* mem_pool_resize_ex(mem_pool_t* pool, void* block, size_t size, enum mem_resize_how* how);
+
+// Allocate memory block of given size from a pool at a multiple of align
+void* mem_pool_alloc_aligned(mem_pool_t* pool, size_t size, size_t align);
+
+// Check in O(1), without locking, whether a pointer lies inside a pool's memory
+// or is one of its mmap'd large blocks
+int mem_pool_owns(mem_pool_t* pool, const void* block);
+
+// Bytes usable in a block allocated from a pool, at least the size asked for
+// (0 if block isn't one)
+size_t mem_pool_block_size(mem_pool_t* pool, void* block);
+
+// Serve requests of at least threshold bytes from mmap regions of their own,
+// released with munmap on free and grown with mremap, so they never carve up
+// the pool. 0 (the default) turns it off. Aligned requests always come from
+// the pool. Returns 0 for a shared pool, which can't do this. Freeing a large
+// block twice is ignored, unless the address has been handed out again as
+// another large block of the pool in between; that block is then freed.
+int mem_pool_set_mmap_threshold(mem_pool_t* pool, size_t threshold);
+
+// Destroy a pool, releasing every block allocated from it in one go
+void mem_pool_destroy(mem_pool_t* pool);
+
+// pthread_atfork handlers for a pool used on both sides of a fork(): prepare
+// takes the pool's lock so that no other thread holds it while the process is
+// copied, parent releases it and child starts with a fresh one. Blocks the
+// other threads had cached are lost to the child, as those threads are.
+void mem_pool_fork_prepare(mem_pool_t* pool);
+void mem_pool_fork_parent(mem_pool_t* pool);
+void mem_pool_fork_child(mem_pool_t* pool);
+
+// Bump-pointer arena for short-lived objects that are released together.
+// It takes one block from a pool; an arena is not meant to be shared between threads.
+typedef struct mem_arena mem_arena_t;
+
+// Create an arena of given size in the default pool (NULL if it doesn't fit)
+mem_arena_t* mem_arena_create(size_t size);
+
+// Create an arena of given size in a pool
+mem_arena_t* mem_pool_arena_create(mem_pool_t* pool, size_t size);
+
+// Allocate memory block of given size from an arena (NULL if it is full)
+void* mem_arena_alloc(mem_arena_t* arena, size_t size);
+
+// Remember how much of an arena is in use
+size_t mem_arena_mark(mem_arena_t* arena);
+
+// Release every block allocated from an arena since mark was taken, in O(1)
+void mem_arena_reset(mem_arena_t* arena, size_t mark);
+
+// Destroy an arena, giving its memory back to the pool
+void mem_arena_destroy(mem_arena_t* arena);
+
+// Slab of count objects of one size, handed out and taken back in O(1).
+// It takes one block from a pool; a slab is not meant to be shared between threads.
+// The objects sit in one array, obj_size rounded up to MEM_ALIGN apart, and a
+// new slab hands them out in address order.
+typedef struct mem_slab mem_slab_t;
+
+// Bytes of pool memory a slab of count objects takes (0 if that is too many)
+size_t mem_slab_size(size_t obj_size, size_t count);
+
+// Create a slab in the default pool (NULL if it doesn't fit)
+mem_slab_t* mem_slab_create(size_t obj_size, size_t count);
+
+// Create a slab in a pool
+mem_slab_t* mem_pool_slab_create(mem_pool_t* pool, size_t obj_size, size_t count);
+
+// Allocate one object from a slab (NULL if it is full)
+void* mem_slab_alloc(mem_slab_t* slab);
+
+// Free an object previously allocated from a slab
+void mem_slab_free(mem_slab_t* slab, void* block);
+
+// First object of a slab's array
+void* mem_slab_objects(mem_slab_t* slab);
+
+// Destroy a slab, giving its memory back to the pool
+void mem_slab_destroy(mem_slab_t* slab);
+
+// What a pool looks like inside. The counts are kept up to date as blocks come
+// and go, so taking a snapshot doesn't walk the blocks and is cheap enough to
+// do at any time.
+struct mem_stats {
+    size_t pool_size;                      // Bytes of pool memory
+    size_t live_blocks;                    // Blocks allocated and not freed yet
+    size_t used_bytes;                     // Bytes not free (thread-cached blocks included)
+    size_t free_bytes;                     // Bytes in free blocks
+    size_t free_blocks;                    // Number of free blocks
+    size_t largest_free;                   // Size of the largest free block
+    double fragmentation;                  // Share of free bytes outside the largest free block (0 to 1)
+    size_t allocs;                         // Successful allocations
+    size_t frees;                          // Blocks freed
+    size_t splits;                         // Blocks cut down, leaving the rest free
+    size_t merges;                         // Free neighbours folded into one block
+    size_t resizes_in_place;               // Resizes that kept the block where it was
+    size_t resizes_shifted;                // Resizes that took in the free block in front
+    size_t resizes_moved;                  // Resizes that moved the block
+    size_t failed_allocs;                  // Allocations and resizes that found no room
+    size_t large_blocks;                   // Blocks with an mmap region of their own
+    size_t large_bytes;                    // Bytes mapped for them
+};
+
+// Take a snapshot of the default pool
+void mem_stats(struct mem_stats* stats);
+
+// Take a snapshot of a pool
+void mem_pool_stats(mem_pool_t* pool, struct mem_stats* stats);
+
+// Operations that are timed and reported to the hook
+enum mem_op { MEM_OP_ALLOC, MEM_OP_FREE, MEM_OP_RESIZE, MEM_OP_COUNT };
+
+// Latency percentiles of one kind of operation, in nanoseconds. Each one is
+// the upper bound of a histogram bucket, which is at most 1/8 wide.
+struct mem_latency {
+    size_t count;                          // Operations timed
+    size_t p50_ns;
+    size_t p99_ns;
+    size_t p999_ns;
+    size_t max_ns;
+};
+
+// Called after every alloc, free and resize on any pool (the mem_* functions
+// included) with the pointer passed in, the pointer returned and the size
+// asked for. Allocations the hook makes itself don't call it again.
+typedef void (*mem_hook_t)(mem_pool_t* pool, enum mem_op op, void* old_block, void* new_block, size_t size, void* arg);
+
+// Tracing is compiled in with -DMEM_TRACE (make TRACE=1); without it the
+// functions below do nothing and return 0, and the hot paths carry no
+// instrumentation at all. Each thread times its operations into its own
+// histogram, without locks.
+
+// Install a hook, or remove it with NULL. Set it before other threads
+// allocate; changing it while they run may pair the old hook with the new arg.
+int mem_set_hook(mem_hook_t hook, void* arg);
+
+// Latency percentiles of op over every thread since the last reset
+int mem_latency(enum mem_op op, struct mem_latency* latency);
+
+// Start the latency histograms over
+void mem_latency_reset(void);
+
 #endif // MEMORY_MANAGER_H
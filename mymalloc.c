@@ -0,0 +1,212 @@
+// malloc, free, realloc, calloc and the aligned variants on top of the memory
+// manager, built as libmymalloc.so. Run any program on it with
+// LD_PRELOAD=./libmymalloc.so <program>.
+#include "memory_manager.h"
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Only the allocator functions are exported; the memory manager stays internal
+#define EXPORT __attribute__((visibility("default")))
+
+// The pool starts at POOL_INITIAL bytes and grows on demand. Its address range is
+// reserved up front: POOL_MAX, or half that, and so on, if the system refuses.
+#define POOL_INITIAL ((size_t)64 << 20)
+#define POOL_MAX ((size_t)64 << 30)
+
+// Requests of at least this many bytes get a mapping of their own from the pool
+#define MMAP_THRESHOLD ((size_t)1 << 20)
+
+// Sits right in front of a block mapped here rather than by the pool
+typedef struct MapHeader {
+    void* base;                 // Start of the mapping
+    size_t length;              // Length of the mapping
+} MapHeader;
+
+static mem_pool_t* pool = NULL;
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+
+// Set while this thread runs inside the memory manager. Anything the manager
+// allocates for itself then gets its own mapping instead of recursing into the pool;
+// this also covers the allocations made while the pool is being set up.
+static __thread int in_manager __attribute__((tls_model("initial-exec")));
+
+// Keep the pool lock out of other threads' hands across fork(), so that a child
+// of a multithreaded program can still allocate
+static void fork_prepare(void) {
+    mem_pool_fork_prepare(pool);
+}
+
+static void fork_parent(void) {
+    mem_pool_fork_parent(pool);
+}
+
+static void fork_child(void) {
+    mem_pool_fork_child(pool);
+}
+
+// Set up the pool on the first allocation
+static void pool_init(void) {
+    for (size_t max = POOL_MAX; max >= POOL_INITIAL && !pool; max /= 2) {
+        pool = mem_pool_create_growable(POOL_INITIAL, max, MEM_MAP_RELEASE);
+    }
+    mem_pool_set_mmap_threshold(pool, MMAP_THRESHOLD);
+    if (pool) pthread_atfork(fork_prepare, fork_parent, fork_child);
+}
+
+// Map a block of size bytes at a multiple of align, with its header in front.
+// Used for what the manager allocates for itself, and if the pool is out of room.
+static void* map_alloc(size_t size, size_t align) {
+    // Step 1: Leave room for the header and for moving the block up to align
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (align < MEM_ALIGN) align = MEM_ALIGN;
+    if (size > SIZE_MAX - sizeof(MapHeader) - align - page) return NULL;
+    size_t length = (size + sizeof(MapHeader) + align + page - 1) & ~(page - 1);
+
+    char* base = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+
+    // Step 2: Place the block behind the header and remember the mapping
+    char* ptr = (char*)(((uintptr_t)base + sizeof(MapHeader) + align - 1) & ~(uintptr_t)(align - 1));
+    MapHeader* header = (MapHeader*)ptr - 1;
+    header->base = base;
+    header->length = length;
+    return ptr;
+}
+
+// Check in O(1) whether a block came from the pool (large blocks included) rather than map_alloc
+static int from_pool(void* ptr) {
+    return pool && mem_pool_owns(pool, ptr);
+}
+
+// Allocate from the pool, at a multiple of align (NULL if it has no room)
+static void* pool_alloc(size_t size, size_t align) {
+    if (in_manager) return NULL;
+
+    in_manager = 1;
+    pthread_once(&pool_once, pool_init);
+    void* ptr = NULL;
+    if (pool) {
+        ptr = align > MEM_ALIGN ? mem_pool_alloc_aligned(pool, size, align) : mem_pool_alloc(pool, size ? size : 1);
+    }
+    in_manager = 0;
+    return ptr;
+}
+
+// Allocate from the pool, falling back to a mapping of its own
+static void* allocate(size_t size, size_t align) {
+    void* ptr = pool_alloc(size, align);
+    if (!ptr) ptr = map_alloc(size, align);
+    if (!ptr) errno = ENOMEM;
+    return ptr;
+}
+
+// Bytes usable in a block
+static size_t usable_size(void* ptr) {
+    if (from_pool(ptr)) {
+        in_manager = 1;
+        size_t size = mem_pool_block_size(pool, ptr);
+        in_manager = 0;
+        return size;
+    }
+
+    MapHeader* header = (MapHeader*)ptr - 1;
+    return (char*)header->base + header->length - (char*)ptr;
+}
+
+EXPORT void* malloc(size_t size) {
+    return allocate(size, MEM_ALIGN);
+}
+
+EXPORT void free(void* ptr) {
+    if (!ptr) return;
+
+    if (from_pool(ptr)) {
+        in_manager = 1;
+        mem_pool_free(pool, ptr);
+        in_manager = 0;
+    } else {
+        MapHeader* header = (MapHeader*)ptr - 1;
+        munmap(header->base, header->length);
+    }
+}
+
+EXPORT void* calloc(size_t count, size_t size) {
+    if (size && count > SIZE_MAX / size) {
+        errno = ENOMEM;
+        return NULL;
+    }
+
+    // Fresh mappings read as zeros already; blocks in the pool's memory may have been used before
+    void* ptr = allocate(count * size, MEM_ALIGN);
+    if (ptr && count * size < MMAP_THRESHOLD && from_pool(ptr)) memset(ptr, 0, count * size);
+    return ptr;
+}
+
+EXPORT void* realloc(void* ptr, size_t size) {
+    // Step 1: realloc(NULL, size) allocates, realloc(ptr, 0) frees
+    if (!ptr) return malloc(size);
+    if (size == 0) {
+        free(ptr);
+        return NULL;
+    }
+
+    // Step 2: The pool resizes its blocks (large ones with mremap); a mapping that is big enough is kept
+    if (from_pool(ptr)) {
+        in_manager = 1;
+        void* new_ptr = mem_pool_resize(pool, ptr, size);
+        in_manager = 0;
+        if (new_ptr) return new_ptr;
+    } else if (size <= usable_size(ptr)) {
+        return ptr;
+    }
+
+    // Step 3: Otherwise move the block
+    size_t old_size = usable_size(ptr);
+    void* new_ptr = malloc(size);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, old_size < size ? old_size : size);
+    free(ptr);
+    return new_ptr;
+}
+
+EXPORT int posix_memalign(void** memptr, size_t align, size_t size) {
+    if (!align || (align & (align - 1)) || align % sizeof(void*)) return EINVAL;
+
+    void* ptr = allocate(size, align);
+    if (!ptr) return ENOMEM;
+    *memptr = ptr;
+    return 0;
+}
+
+EXPORT void* aligned_alloc(size_t align, size_t size) {
+    if (!align || (align & (align - 1))) {
+        errno = EINVAL;
+        return NULL;
+    }
+    return allocate(size, align);
+}
+
+EXPORT void* memalign(size_t align, size_t size) {
+    return aligned_alloc(align, size);
+}
+
+EXPORT void* valloc(size_t size) {
+    return allocate(size, (size_t)sysconf(_SC_PAGESIZE));
+}
+
+EXPORT void* pvalloc(size_t size) {
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    if (size > SIZE_MAX - page) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    return allocate((size + page - 1) & ~(page - 1), page);
+}
+
+EXPORT size_t malloc_usable_size(void* ptr) {
+    return ptr ? usable_size(ptr) : 0;
+}
@@ -0,0 +1,217 @@
+#include "offset_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Static_assert(sizeof(OffsetNode) == 8, "OffsetNode must take 8 bytes");
+_Static_assert(sizeof(OffsetList) % sizeof(OffsetNode) == 0, "Nodes must start aligned behind the descriptor");
+
+// Node at an offset from the start of the list (NULL for offset 0)
+static OffsetNode* node_at(OffsetList* list, uint32_t offset) {
+    return offset ? (OffsetNode*)((char*)list + offset) : NULL;
+}
+
+// Offset of a node from the start of the list (0 for NULL)
+static uint32_t node_offset(OffsetList* list, OffsetNode* node) {
+    return node ? (uint32_t)((char*)node - (char*)list) : 0;
+}
+
+// Take a node from the list's unused nodes
+static OffsetNode* node_alloc(OffsetList* list, uint16_t data) {
+    OffsetNode* node = node_at(list, list->free_nodes);
+    if (node) {
+        list->free_nodes = node->next;
+        node->next = 0;
+        node->data = data;
+    }
+    return node;
+}
+
+// Give a node back to the list's unused nodes
+static void node_free(OffsetList* list, OffsetNode* node) {
+    node->next = list->free_nodes;
+    list->free_nodes = node_offset(list, node);
+}
+
+// Bytes of memory an offset list with room for count nodes takes
+size_t olist_size(size_t count) {
+    return sizeof(OffsetList) + count * sizeof(OffsetNode);
+}
+
+// Set up an empty list in a block of size bytes (NULL if not even the descriptor fits).
+// Offsets are 32 bits, so at most 4 GiB of the block is used.
+OffsetList* olist_init(void* memory, size_t size) {
+    // Step 1: Check that the descriptor fits
+    if (!memory || size < sizeof(OffsetList)) {
+        return NULL;
+    }
+    if (size > UINT32_MAX) {
+        size = UINT32_MAX;
+    }
+
+    // Step 2: Start out empty
+    OffsetList* list = memory;
+    size_t count = (size - sizeof(OffsetList)) / sizeof(OffsetNode);
+    list->head = 0;
+    list->tail = 0;
+    list->count = 0;
+    list->free_nodes = 0;
+    list->size = (uint32_t)olist_size(count);
+    list->reserved = 0;
+
+    // Step 3: Put all nodes on the free list, lowest offset first
+    OffsetNode* nodes = (OffsetNode*)(list + 1);
+    for (size_t i = count; i > 0; i--) {
+        node_free(list, &nodes[i - 1]);
+    }
+    return list;
+}
+
+// Set up an empty list in a block of size bytes taken from a pool
+OffsetList* olist_create(mem_pool_t* pool, size_t size) {
+    void* memory = size >= sizeof(OffsetList) ? mem_pool_alloc(pool, size) : NULL;
+    if (!memory) {
+        fprintf(stderr, "Error: Memory allocation failed in olist_create.\n");
+        return NULL;
+    }
+    return olist_init(memory, size);
+}
+
+// Insert a node at the end of the list
+void olist_insert(OffsetList* list, uint16_t data) {
+    // Step 1: Take a node
+    OffsetNode* new_node = node_alloc(list, data);
+    if (!new_node) {
+        fprintf(stderr, "Error: Memory allocation failed in olist_insert.\n");
+        return;
+    }
+
+    // Step 2: Hang it behind the tail (or make it the head of an empty list)
+    uint32_t offset = node_offset(list, new_node);
+    if (list->tail) {
+        node_at(list, list->tail)->next = offset;
+    } else {
+        list->head = offset;
+    }
+    list->tail = offset;
+    list->count++;
+}
+
+// Insert a node after a specific node
+void olist_insert_after(OffsetList* list, OffsetNode* prev_node, uint16_t data) {
+    // Step 1: Check if previous node exists
+    if (!prev_node) {
+        fprintf(stderr, "Error: prev_node is NULL in olist_insert_after.\n");
+        return;
+    }
+
+    // Step 2: Take a node
+    OffsetNode* new_node = node_alloc(list, data);
+    if (!new_node) {
+        fprintf(stderr, "Error: Memory allocation failed in olist_insert_after.\n");
+        return;
+    }
+
+    // Step 3: Link it in behind prev_node
+    uint32_t offset = node_offset(list, new_node);
+    new_node->next = prev_node->next;
+    prev_node->next = offset;
+    if (list->tail == node_offset(list, prev_node)) list->tail = offset;
+    list->count++;
+}
+
+// Insert a node before a specific node
+void olist_insert_before(OffsetList* list, OffsetNode* next_node, uint16_t data) {
+    // Step 1: Check if next node exists
+    if (!next_node) {
+        fprintf(stderr, "Error: next_node is NULL in olist_insert_before.\n");
+        return;
+    }
+
+    // Step 2: Inserting before the head makes a new head
+    uint32_t next = node_offset(list, next_node);
+    if (list->head == next) {
+        OffsetNode* new_node = node_alloc(list, data);
+        if (!new_node) {
+            fprintf(stderr, "Error: Memory allocation failed in olist_insert_before.\n");
+            return;
+        }
+        new_node->next = next;
+        list->head = node_offset(list, new_node);
+        list->count++;
+        return;
+    }
+
+    // Step 3: Otherwise find the node before next_node and insert after it
+    OffsetNode* prev = node_at(list, list->head);
+    while (prev && prev->next != next) {
+        prev = node_at(list, prev->next);
+    }
+    if (!prev) {
+        fprintf(stderr, "Error: next_node not found in olist_insert_before.\n");
+        return;
+    }
+    olist_insert_after(list, prev, data);
+}
+
+// Delete the first node holding data
+void olist_delete(OffsetList* list, uint16_t data) {
+    // Step 1: Find the node with matching data, keeping track of the one before it
+    OffsetNode* prev = NULL;
+    OffsetNode* current = node_at(list, list->head);
+    while (current && current->data != data) {
+        prev = current;
+        current = node_at(list, current->next);
+    }
+
+    // Step 2: If not found, print error
+    if (!current) {
+        fprintf(stderr, "Error: Data %u not found in olist_delete.\n", data);
+        return;
+    }
+
+    // Step 3: Unlink it and free it; the node before it may become the tail
+    if (prev) {
+        prev->next = current->next;
+    } else {
+        list->head = current->next;
+    }
+    if (list->tail == node_offset(list, current)) list->tail = node_offset(list, prev);
+    node_free(list, current);
+    list->count--;
+}
+
+// Search for the first node holding data
+OffsetNode* olist_search(OffsetList* list, uint16_t data) {
+    for (OffsetNode* current = node_at(list, list->head); current; current = node_at(list, current->next)) {
+        if (current->data == data) {
+            return current;
+        }
+    }
+    return NULL;
+}
+
+// Display the whole list
+void olist_display(OffsetList* list) {
+    // Step 1: Print each value, separated by ", "
+    printf("[");
+    for (OffsetNode* current = node_at(list, list->head); current; current = node_at(list, current->next)) {
+        if (current != node_at(list, list->head)) {
+            printf(", ");
+        }
+        printf("%u", current->data);
+    }
+
+    // Step 2: Close the output
+    printf("]");
+}
+
+// Number of nodes in the list, in O(1)
+size_t olist_count(OffsetList* list) {
+    return list->count;
+}
+
+// Give a list made by olist_create back to its pool
+void olist_destroy(mem_pool_t* pool, OffsetList* list) {
+    mem_pool_free(pool, list);
+}
@@ -0,0 +1,51 @@
+#ifndef OFFSET_LIST_H
+#define OFFSET_LIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "memory_manager.h"
+
+// Node linked by offset: next is the byte offset of the next node from the start
+// of the list (0 after the last node), so a node takes 8 bytes instead of 16
+typedef struct OffsetNode {
+    uint32_t next;
+    uint16_t data;
+} OffsetNode;
+
+// Offset list. The descriptor sits at the start of one block of memory with the
+// nodes behind it. Nothing in the block is a pointer, so the block can be copied,
+// mapped from a file or shared between processes and used at its new address.
+typedef struct OffsetList {
+    uint32_t head;              // Offset of the first node, 0 for an empty list
+    uint32_t tail;              // Offset of the last node
+    uint32_t count;             // Number of nodes
+    uint32_t free_nodes;        // Offset of the first unused node; unused nodes are chained through next
+    uint32_t size;              // Bytes of the block in use, descriptor included
+    uint32_t reserved;
+} OffsetList;
+
+// First node of the list (NULL if it is empty); inline so that walks cost no calls
+static inline OffsetNode* olist_head(OffsetList* list) {
+    return list->head ? (OffsetNode*)((char*)list + list->head) : NULL;
+}
+
+// Node after node (NULL after the last one)
+static inline OffsetNode* olist_next(OffsetList* list, OffsetNode* node) {
+    return node->next ? (OffsetNode*)((char*)list + node->next) : NULL;
+}
+
+// Function prototypes
+size_t olist_size(size_t count);
+OffsetList* olist_init(void* memory, size_t size);
+OffsetList* olist_create(mem_pool_t* pool, size_t size);
+void olist_insert(OffsetList* list, uint16_t data);
+void olist_insert_after(OffsetList* list, OffsetNode* prev_node, uint16_t data);
+void olist_insert_before(OffsetList* list, OffsetNode* next_node, uint16_t data);
+void olist_delete(OffsetList* list, uint16_t data);
+OffsetNode* olist_search(OffsetList* list, uint16_t data);
+void olist_display(OffsetList* list);
+size_t olist_count(OffsetList* list);
+void olist_destroy(mem_pool_t* pool, OffsetList* list);
+
+#endif // OFFSET_LIST_H
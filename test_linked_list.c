@@ -4,6 +4,8 @@
 #include <assert.h>
 #include <time.h>
 #include <stddef.h>
+#include <unistd.h>
+#include <pthread.h>
 
 #include "common_defs.h"
 #include "gitdata.h"
@@ -166,7 +168,7 @@ void test_list_display()
 
     char *stringFull = malloc(1024);
     char *string2Last = malloc(1024);
-    char *string1third = malloc(1024);
+    char *string1third = calloc(1, 1024);
     char *stringRandom = malloc(1024);
 
     sprintf(stringFull, "[");
@@ -184,7 +186,16 @@ void test_list_display()
     }
     for (int k = 0; k < Nnodes; k++)
     {
-        values[k] = 10 + rand() % 90;
+        // Distinct values, so that list_search and strstr below find the node inserted at k
+        int unique;
+        do
+        {
+            values[k] = 10 + rand() % 90;
+            unique = 1;
+            for (int j = 0; j < k; j++)
+                if (values[j] == values[k])
+                    unique = 0;
+        } while (!unique);
         list_insert(&head, values[k]);
         if (k == randomLow && !Low)
         {
@@ -264,7 +275,7 @@ void test_list_display()
 
 #endif
 
-    char *blob = malloc(1024);
+    char *blob = calloc(1, 1024);
     strncpy(blob, start, LenToLast - LenToFirst);
 
     sprintf(stringRandom, "[%s", blob);
@@ -483,6 +494,474 @@ void test_list_edge_cases()
     printf_green("[PASS].\n");
 }
 
+// Worker for test_list_pool: build, search and tear down lists of its own, round robin
+static void *list_worker(void *arg)
+{
+    int seed = (int)(size_t)arg;
+    Node *heads[250];
+    for (int l = 0; l < 250; l++)
+    {
+        heads[l] = NULL;
+        list_init(&heads[l], sizeof(Node) * 40);
+        list_insert(&heads[l], (uint16_t)(seed + l));
+    }
+    for (int k = 0; k < 30; k++)
+        for (int l = 0; l < 250; l++)
+        {
+            list_insert_after(heads[l], (uint16_t)k);
+            if (list_search(&heads[l], (uint16_t)k) == NULL)
+                return (void *)1;
+        }
+    for (int l = 0; l < 250; l++)
+    {
+        if (list_count_nodes(&heads[l]) != 31 || heads[l]->data != (uint16_t)(seed + l))
+            return (void *)1;
+        list_cleanup(&heads[l]);
+    }
+    return NULL;
+}
+
+void test_list_pool()
+{
+    printf_yellow("  Testing list pool bounds ---> ");
+    Node *head = NULL;
+    Node *other = NULL;
+    list_init(&head, sizeof(Node) * 2);
+    list_init(&other, sizeof(Node) * 2);
+
+    // Nodes come out of one contiguous pool that holds exactly two of them
+    list_insert(&head, 10);
+    list_insert(&head, 20);
+    list_insert(&head, 30);
+    my_assert(list_count_nodes(&head) == 2);
+    my_assert(head->next == head + 1);
+
+    // A deleted node's slot can be reused, and the other list has its own pool
+    list_delete(&head, 10);
+    list_insert(&head, 30);
+    my_assert(list_count_nodes(&head) == 2);
+    list_insert(&other, 40);
+    my_assert(other != NULL && other->data == 40);
+
+    list_cleanup(&head);
+    list_cleanup(&other);
+    my_assert(head == NULL && other == NULL);
+
+    // A thousand lists used from four threads, each finding its own lists' pools
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++)
+        my_assert(pthread_create(&threads[t], NULL, list_worker, (void *)(size_t)(1000 * (t + 1))) == 0);
+    for (int t = 0; t < 4; t++)
+    {
+        void *failed;
+        my_assert(pthread_join(threads[t], &failed) == 0 && failed == NULL);
+    }
+    printf_green("[PASS].\n");
+}
+
+void test_list_descriptor(int count)
+{
+    printf_yellow("  Testing list append/prepend/count ---> ");
+    List list;
+    list_create(&list, sizeof(Node) * (count + 1));
+    my_assert(list_count(&list) == 0);
+
+    // Appending stays O(1), so a long list builds quickly and in order
+    for (int i = 0; i < count; i++)
+    {
+        list_append(&list, i);
+    }
+    list_prepend(&list, 12345);
+    my_assert(list_count(&list) == (size_t)count + 1);
+    my_assert(list.head->data == 12345);
+    my_assert(list.tail->data == (uint16_t)(count - 1));
+    my_assert(list_count_nodes(&list.head) == count + 1);
+
+    // A prepend into an empty list sets the tail as well
+    list_destroy(&list);
+    my_assert(list.head == NULL && list_count(&list) == 0);
+    list_create(&list, sizeof(Node) * 2);
+    list_prepend(&list, 1);
+    list_append(&list, 2);
+    my_assert(list.head->data == 1 && list.tail->data == 2 && list.head->next == list.tail);
+
+    list_destroy(&list);
+    printf_green("[PASS].\n");
+}
+
+// Position of a node in a list (-1 for NULL)
+int node_position(List *list, Node *node)
+{
+    int position = 0;
+    if (!node)
+        return -1;
+    for (Node *current = list->head; current != node; current = current->next)
+        position++;
+    return position;
+}
+
+// Check that two lists hold the same values and that list_search finds the same positions in both
+void check_same_lists(List *indexed, List *plain)
+{
+    Node *a = indexed->head;
+    Node *b = plain->head;
+    while (a && b)
+    {
+        my_assert(a->data == b->data);
+        a = a->next;
+        b = b->next;
+    }
+    my_assert(a == NULL && b == NULL);
+
+    for (int value = 0; value < 40; value++)
+    {
+        my_assert(node_position(indexed, list_search(&indexed->head, value)) ==
+                  node_position(plain, list_search(&plain->head, value)));
+    }
+}
+
+void test_list_indexed()
+{
+    printf_yellow("  Testing indexed list mode ---> ");
+    List indexed;
+    List plain;
+    list_create_indexed(&indexed, sizeof(Node) * 24000);
+    list_create(&plain, sizeof(Node) * 24000);
+    my_assert(list_index_size(&indexed) > 0 && list_index_size(&plain) == 0);
+
+    // Descriptor operations; few distinct values, so every value has many nodes
+    for (int i = 0; i < 2000; i++)
+    {
+        int value = rand() % 32;
+        int op = rand() % 4;
+        if (op == 0)
+        {
+            list_prepend(&indexed, value);
+            list_prepend(&plain, value);
+        }
+        else if (op == 1 && list_search(&plain.head, value))
+        {
+            list_remove(&indexed, value);
+            list_remove(&plain, value);
+        }
+        else
+        {
+            list_append(&indexed, value);
+            list_append(&plain, value);
+        }
+    }
+    check_same_lists(&indexed, &plain);
+    my_assert(list_count(&indexed) == list_count(&plain));
+
+    // Node** operations in the middle of the list
+    for (int i = 0; i < 1000; i++)
+    {
+        int value = rand() % 32;
+        int other = rand() % 40;
+        Node *at_a = list_search(&indexed.head, value);
+        Node *at_b = list_search(&plain.head, value);
+        int op = rand() % 3;
+        if (at_a && op == 0)
+        {
+            list_insert_after(at_a, other);
+            list_insert_after(at_b, other);
+        }
+        else if (at_a && op == 1)
+        {
+            list_insert_before(&indexed.head, at_a, other);
+            list_insert_before(&plain.head, at_b, other);
+        }
+        else if (at_a)
+        {
+            list_delete(&indexed.head, value);
+            list_delete(&plain.head, value);
+        }
+    }
+    check_same_lists(&indexed, &plain);
+
+    // Inserts piling up at one place use up the room between order keys again and again
+    my_assert(indexed.head != NULL);
+    for (int i = 0; i < 20000; i++)
+    {
+        int value = rand() % 40;
+        list_insert_after(indexed.head->next ? indexed.head->next : indexed.head, value);
+        list_insert_after(plain.head->next ? plain.head->next : plain.head, value);
+    }
+    check_same_lists(&indexed, &plain);
+    for (int i = 0; i < 5000; i++)
+    {
+        int value = rand() % 40;
+        if (list_search(&plain.head, value))
+        {
+            list_delete(&indexed.head, value);
+            list_delete(&plain.head, value);
+        }
+    }
+    check_same_lists(&indexed, &plain);
+
+    list_destroy(&indexed);
+    list_destroy(&plain);
+    printf_green("[PASS].\n");
+}
+
+// Predicate for list_delete_if: odd values
+int is_odd(uint16_t data, void *ctx)
+{
+    (void)ctx;
+    return data % 2;
+}
+
+void test_list_bulk()
+{
+    printf_yellow("  Testing bulk insert and delete ---> ");
+    uint16_t values[1000];
+    for (int i = 0; i < 1000; i++)
+    {
+        values[i] = i % 10;
+    }
+
+    // Bulk insert goes behind the existing nodes, in order, or not at all
+    Node *head = NULL;
+    list_init(&head, sizeof(Node) * 1001);
+    list_insert(&head, 42);
+    list_insert_bulk(&head, values, 1000);
+    my_assert(list_count_nodes(&head) == 1001 && head->data == 42 && head->next->next->data == 1);
+    list_insert_bulk(&head, values, 1);
+    my_assert(list_count_nodes(&head) == 1001);
+
+    // Delete all matches in one go
+    my_assert(list_delete_all(&head, 7) == 100);
+    my_assert(list_search(&head, 7) == NULL);
+    my_assert(list_delete_if(&head, is_odd, NULL) == 400);
+    my_assert(list_count_nodes(&head) == 501 && list_search(&head, 3) == NULL);
+    list_cleanup(&head);
+
+    // The descriptor versions keep tail, count and the index up to date
+    List indexed;
+    List plain;
+    list_create_indexed(&indexed, sizeof(Node) * 2000);
+    list_create(&plain, sizeof(Node) * 2000);
+    list_append_bulk(&indexed, values, 1000);
+    list_append_bulk(&plain, values, 1000);
+    my_assert(list_remove_all(&indexed, 9) == 100 && list_remove_all(&plain, 9) == 100);
+    my_assert(indexed.tail->data == 8 && plain.tail->data == 8);
+    my_assert(list_remove_if(&indexed, is_odd, NULL) == 400 && list_remove_if(&plain, is_odd, NULL) == 400);
+    my_assert(list_count(&indexed) == 500 && list_count(&plain) == 500);
+    my_assert(indexed.tail->data == 8 && plain.tail->data == 8);
+    list_append_bulk(&indexed, values, 5);
+    list_append_bulk(&plain, values, 5);
+    check_same_lists(&indexed, &plain);
+    my_assert(indexed.tail->data == 4 && list_count(&indexed) == 505);
+
+    list_destroy(&indexed);
+    list_destroy(&plain);
+    printf_green("[PASS].\n");
+}
+
+void test_list_format()
+{
+    printf_yellow("  Testing list_format and list_write ---> ");
+    char buffer[1024];
+    char expected[1024] = {0};
+    Node *head = NULL;
+    list_init(&head, sizeof(Node) * 20007);
+
+    my_assert(list_format(&head, buffer, sizeof(buffer)) == 2 && strcmp(buffer, "[]") == 0);
+    uint16_t values[] = {0, 7, 10, 99, 100, 65535, 1234};
+    list_insert_bulk(&head, values, 7);
+    my_assert(list_format(&head, buffer, sizeof(buffer)) == 32);
+    my_assert(strcmp(buffer, "[0, 7, 10, 99, 100, 65535, 1234]") == 0);
+
+    // Like snprintf: too small a buffer gets cut off but the full length is returned
+    my_assert(list_format(&head, buffer, 6) == 32 && strcmp(buffer, "[0, 7") == 0);
+    my_assert(list_format(&head, NULL, 0) == 32);
+
+    // A range matches what list_display_range prints
+    Node *start = list_search(&head, 10);
+    Node *end = list_search(&head, 65535);
+    list_format_range(&head, start, end, buffer, sizeof(buffer));
+    capture_stdout(expected, sizeof(expected), (void (*)(Node **, Node *, Node *))list_display_range, &head, start, end);
+    my_assert(strcmp(buffer, "[10, 99, 100, 65535]") == 0 && strcmp(buffer, expected) == 0);
+
+    // Streaming to a FILE* and to an fd gives the same text, also when it takes several chunks
+    uint16_t more[20000];
+    for (int i = 0; i < 20000; i++)
+    {
+        more[i] = 60000 + i % 5000;
+    }
+    list_insert_bulk(&head, more, 20000);
+    size_t length = list_format(&head, NULL, 0);
+    char *text = malloc(length + 1);
+    char *written = malloc(length + 1);
+    my_assert(length > 65536 && list_format(&head, text, length + 1) == length);
+    for (int use_fd = 0; use_fd <= 1; use_fd++)
+    {
+        FILE *fp = tmpfile();
+        my_assert(fp != NULL);
+        if (use_fd)
+            my_assert(list_write_fd(&head, fileno(fp)) == 0);
+        else
+            my_assert(list_write(&head, fp) == 0);
+        fflush(fp);
+        rewind(fp);
+        size_t got = fread(written, 1, length, fp);
+        written[got] = '\0';
+        fclose(fp);
+        my_assert(got == length && strcmp(text, written) == 0);
+    }
+
+    free(text);
+    free(written);
+    list_cleanup(&head);
+    printf_green("[PASS].\n");
+}
+
+void test_list_snapshot()
+{
+    printf_yellow("  Testing list_save and list_load ---> ");
+    char path[] = "/tmp/test_linked_list_XXXXXX";
+    int fd = mkstemp(path);
+    my_assert(fd >= 0);
+    close(fd);
+    char saved[1024] = {0};
+    char loaded[1024] = {0};
+
+    // Churn the list first, so its nodes are spread out over the pool
+    Node *head = NULL;
+    list_init(&head, sizeof(Node) * 100);
+    for (int i = 0; i < 100; i++)
+    {
+        list_insert(&head, i);
+    }
+    for (int i = 0; i < 100; i += 3)
+    {
+        list_delete(&head, i);
+    }
+    list_insert_before(&head, list_search(&head, 50), 1000);
+    list_format(&head, saved, sizeof(saved));
+    my_assert(list_save(&head, path) == 0);
+
+    // The loaded list has the same values, and room for more as asked
+    Node *copy = NULL;
+    my_assert(list_load(&copy, path, sizeof(Node) * 70) == 0);
+    list_format(&copy, loaded, sizeof(loaded));
+    my_assert(strcmp(saved, loaded) == 0 && list_count_nodes(&copy) == 67);
+    for (int i = 0; i < 3; i++)
+    {
+        list_insert(&copy, 2000 + i);
+    }
+    my_assert(list_count_nodes(&copy) == 70 && list_search(&copy, 2002) != NULL);
+    list_delete(&copy, 1000);
+    my_assert(list_search(&copy, 1000) == NULL);
+
+    // Too little room or a damaged file leave the list empty
+    my_assert(list_load(&copy, path, sizeof(Node) * 66) == -1);
+    FILE *fp = fopen(path, "r+b");
+    my_assert(fp != NULL);
+    fputc('X', fp);
+    fclose(fp);
+    my_assert(list_load(&copy, path, sizeof(Node) * 100) == -1 && copy == NULL);
+
+    // So does a file whose records link back into a cycle: the last of two links to the first
+    Node *pair = NULL;
+    uint32_t first_record = 0;
+    list_init(&pair, sizeof(Node) * 2);
+    list_insert(&pair, 1);
+    list_insert(&pair, 2);
+    my_assert(list_save(&pair, path) == 0);
+    fp = fopen(path, "r+b");
+    my_assert(fp != NULL && fseek(fp, 24 + 8, SEEK_SET) == 0);
+    my_assert(fwrite(&first_record, sizeof(first_record), 1, fp) == 1);
+    fclose(fp);
+    my_assert(list_load(&copy, path, sizeof(Node) * 2) == -1 && copy == NULL);
+    list_cleanup(&pair);
+
+    // The descriptor version sets tail and count; an empty list round trips too
+    List list;
+    my_assert(list_save(&head, path) == 0);
+    my_assert(list_create_from_file(&list, path, sizeof(Node) * 67) == 0);
+    my_assert(list_count(&list) == 67 && list.tail->data == 98 && list.tail->next == NULL);
+    list_destroy(&list);
+    list_cleanup(&head);
+    my_assert(list_save(&head, path) == 0);
+    my_assert(list_create_from_file(&list, path, 0) == 0);
+    my_assert(list.head == NULL && list.tail == NULL && list_count(&list) == 0);
+    list_destroy(&list);
+
+    list_cleanup(&copy);
+    unlink(path);
+    printf_green("[PASS].\n");
+}
+
+// Helpers for test_list_lifetime: build a list from a local head and hand it back
+static Node *make_list(uint16_t value)
+{
+    Node *head;
+    list_init(&head, sizeof(Node) * 4);
+    list_insert(&head, value);
+    return head;
+}
+
+static List make_descriptor(void)
+{
+    List list;
+    list_create(&list, sizeof(Node) * 4);
+    return list;
+}
+
+void test_list_lifetime()
+{
+    printf_yellow("  Testing lists returned from helpers and copied ---> ");
+    char buffer[64];
+
+    // Both helper calls init the same local head; the second must not release the first list
+    Node *first = make_list(1);
+    Node *second = make_list(2);
+    list_insert(&first, 10);
+    list_insert(&second, 20);
+    my_assert(list_format(&first, buffer, sizeof(buffer)) == 7 && strcmp(buffer, "[1, 10]") == 0);
+    my_assert(list_format(&second, buffer, sizeof(buffer)) == 7 && strcmp(buffer, "[2, 20]") == 0);
+
+    // Re-initing a head starts a new list; the old one lives on under a copy of its head
+    Node *head = NULL;
+    list_init(&head, sizeof(Node) * 2);
+    list_insert(&head, 5);
+    Node *old = head;
+    list_init(&head, sizeof(Node) * 2);
+    my_assert(head == NULL);
+    list_insert(&head, 6);
+    list_insert(&old, 7);
+    my_assert(list_count_nodes(&old) == 2 && old->next->data == 7);
+    my_assert(list_count_nodes(&head) == 1 && head->data == 6);
+
+    // A non-empty head can be copied; an empty one is only known by the variable list_init got
+    Node *copy = head;
+    list_insert(&copy, 8);
+    my_assert(head->next != NULL && head->next->data == 8);
+    Node *empty = NULL;
+    list_init(&empty, sizeof(Node) * 2);
+    Node *empty_copy = empty;
+    list_insert(&empty_copy, 9);
+    my_assert(empty_copy == NULL);
+    list_insert(&empty, 9);
+    my_assert(empty != NULL && empty->data == 9);
+
+    // A List keeps its pool, so a copy of an empty one works
+    List list = make_descriptor();
+    list_append(&list, 3);
+    list_prepend(&list, 4);
+    my_assert(list_count(&list) == 2 && list.head->data == 4 && list.tail->data == 3);
+
+    list_destroy(&list);
+    list_cleanup(&empty);
+    list_cleanup(&head);
+    list_cleanup(&old);
+    list_cleanup(&second);
+    list_cleanup(&first);
+    my_assert(first == NULL && second == NULL && old == NULL && head == NULL);
+    printf_green("[PASS].\n");
+}
+
 // Main function to run all tests
 int main(int argc, char *argv[])
 {
@@ -513,6 +992,13 @@ int main(int argc, char *argv[])
         printf(" 12. test_list_delete_loop - Test multiple detelions\n");
         printf(" 13. test_list_search_loop - Test multiple search\n");
         printf(" 14. test_list_edge_cases - Test edge cases\n");
+        printf(" 15. test_list_pool - Test that nodes come from a pool sized by list_init\n");
+        printf(" 16. test_list_descriptor - Test O(1) append, prepend and count on a List\n");
+        printf(" 17. test_list_indexed - Test that an indexed list behaves like a plain one\n");
+        printf(" 18. test_list_bulk - Test bulk insert and delete\n");
+        printf(" 19. test_list_format - Test formatting into a buffer and streaming out\n");
+        printf(" 20. test_list_snapshot - Test saving a list to a file and loading it back\n");
+        printf(" 21. test_list_lifetime - Test lists returned from helpers and copied\n");
         printf(" 0. Run all tests\n");
 	printf(" 100. Run all tests; -test_list_display() \n");
         return 1;
@@ -540,6 +1026,13 @@ int main(int argc, char *argv[])
         test_list_delete_loop(1000);
         test_list_search_loop(1000);
         test_list_edge_cases();
+        test_list_pool();
+        test_list_descriptor(100000);
+        test_list_indexed();
+        test_list_bulk();
+        test_list_format();
+        test_list_snapshot();
+        test_list_lifetime();
         break;
     case 0:
         printf("Testing Basic Operations:\n");
@@ -559,6 +1052,13 @@ int main(int argc, char *argv[])
         test_list_delete_loop(1000);
         test_list_search_loop(1000);
         test_list_edge_cases();
+        test_list_pool();
+        test_list_descriptor(100000);
+        test_list_indexed();
+        test_list_bulk();
+        test_list_format();
+        test_list_snapshot();
+        test_list_lifetime();
         break;
     case 1:
         test_list_init();
@@ -603,6 +1103,27 @@ int main(int argc, char *argv[])
     case 14:
         test_list_edge_cases();
         break;
+    case 15:
+        test_list_pool();
+        break;
+    case 16:
+        test_list_descriptor(100000);
+        break;
+    case 17:
+        test_list_indexed();
+        break;
+    case 18:
+        test_list_bulk();
+        break;
+    case 19:
+        test_list_format();
+        break;
+    case 20:
+        test_list_snapshot();
+        break;
+    case 21:
+        test_list_lifetime();
+        break;
 
     default:
         printf("Invalid test function\n");
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE
 #include "memory_manager.h"
 #include <stdio.h>
 #include <assert.h>
@@ -7,6 +8,11 @@
 #include <dlfcn.h>
 #include <sys/mman.h>
 #include <fcntl.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <errno.h>
 #include "common_defs.h"
 
 #include "gitdata.h"
@@ -354,11 +360,12 @@ void test_looking_for_out_of_bounds(int size){
   void *block3 = mem_alloc(2048); // 2048-4096
   assert(block3 != NULL);
 
-  void *block4 = mem_alloc(904); // 4096-5000
+  void *block4 = mem_alloc(904); // 4096-5008, rounded up to MEM_ALIGN
   assert(block4 != NULL);
 
-  int lastBlock=size-5000;
-  void *block5 = mem_alloc(lastBlock); // size-5000
+  int used=4096+((904+MEM_ALIGN-1)&~(MEM_ALIGN-1));
+  int lastBlock=size-used;
+  void *block5 = mem_alloc(lastBlock); // The rest of the pool
   assert(block5 != NULL);
 
   printf("BLOCK0; %p, 512\n", block0);
@@ -406,6 +413,861 @@ void test_mmap(){
    
 }
 
+void test_free_random_order()
+{
+    printf_yellow("  Testing mem_free in random order ---> ");
+    const int nBlocks = 2000;
+    mem_init(nBlocks * 64);
+    void *blocks[nBlocks];
+
+    for (int k = 0; k < nBlocks; k++)
+    {
+        blocks[k] = mem_alloc(64);
+        my_assert(blocks[k] != NULL);
+    }
+    for (int k = nBlocks - 1; k > 0; k--)
+    {
+        int j = rand() % (k + 1);
+        void *tmp = blocks[k];
+        blocks[k] = blocks[j];
+        blocks[j] = tmp;
+    }
+    for (int k = 0; k < nBlocks; k++)
+    {
+        mem_free(blocks[k]);
+    }
+
+    void *block = mem_alloc(nBlocks * 64); // Every neighbour must have been merged again
+    my_assert(block != NULL);
+
+    mem_free(block);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_fixed_metadata()
+{
+    printf_yellow("  Testing mem_init_fixed metadata limit ---> ");
+    mem_init_fixed(1024, 4);
+    size_t heap_used = mallinfo2().uordblks;
+
+    void *block1 = mem_alloc(100);
+    void *block2 = mem_alloc(100);
+    void *block3 = mem_alloc(100); // The remainder takes the last node
+    my_assert(block1 != NULL && block2 != NULL && block3 != NULL);
+    void *block4 = mem_alloc(100); // No node left to split with, gets the whole rest
+    my_assert(block4 != NULL);
+    void *block5 = mem_alloc(100);
+    my_assert(block5 == NULL);
+
+    mem_free(block2);
+    mem_free(block1);
+    mem_free(block4);
+    mem_free(block3);
+    void *block6 = mem_alloc(1024); // Everything merged back, nodes were recycled
+    my_assert(block6 != NULL);
+    mem_free(block6);
+
+    // Small blocks skip the thread cache, which would take a malloc and hold on to nodes
+    void *small1 = mem_alloc(16);
+    void *small2 = mem_alloc(64);
+    my_assert(small1 != NULL && small2 != NULL);
+    mem_free(small1);
+    mem_free(small2);
+    block6 = mem_alloc(1024);
+    my_assert(block6 != NULL);
+    mem_free(block6);
+
+    my_assert(mallinfo2().uordblks == heap_used); // No system allocations after init
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+// Worker for test_threads: churn through small and large blocks and check their contents
+static void *thread_worker(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    unsigned char *blocks[32] = {0};
+    size_t sizes[32] = {0};
+
+    for (int round = 0; round < 20000; round++)
+    {
+        int k = rand_r(&seed) % 32;
+        if (blocks[k])
+        {
+            for (size_t i = 0; i < sizes[k]; i++)
+                my_assert(blocks[k][i] == (unsigned char)k);
+            mem_free(blocks[k]);
+            blocks[k] = NULL;
+        }
+        else
+        {
+            sizes[k] = 1 + rand_r(&seed) % (rand_r(&seed) % 4 ? 64 : 512);
+            blocks[k] = mem_alloc(sizes[k]);
+            my_assert(blocks[k] != NULL);
+            memset(blocks[k], k, sizes[k]);
+        }
+    }
+    for (int k = 0; k < 32; k++)
+        mem_free(blocks[k]);
+    return NULL;
+}
+
+void test_threads()
+{
+    printf_yellow("  Testing concurrent mem_alloc and mem_free ---> ");
+    const int nThreads = 8;
+    const int poolSize = 1024 * 1024;
+    pthread_t threads[nThreads];
+    mem_init(poolSize);
+
+    for (int t = 0; t < nThreads; t++)
+        pthread_create(&threads[t], NULL, thread_worker, (void *)(size_t)(t + 1));
+    for (int t = 0; t < nThreads; t++)
+        pthread_join(threads[t], NULL);
+
+    void *block = mem_alloc(poolSize); // Thread caches were handed back on exit
+    my_assert(block != NULL);
+
+    mem_free(block);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_multiple_pools()
+{
+    printf_yellow("  Testing independent pools ---> ");
+    mem_pool_t *pool1 = mem_pool_create(1024);
+    mem_pool_t *pool2 = mem_pool_create(1024);
+    my_assert(pool1 != NULL && pool2 != NULL);
+
+    void *block1 = mem_pool_alloc(pool1, 1024); // Each pool has its own 1KB
+    void *block2 = mem_pool_alloc(pool2, 1024);
+    my_assert(block1 != NULL && block2 != NULL);
+    my_assert(mem_pool_alloc(pool1, 1) == NULL);
+
+    mem_pool_free(pool2, block1); // Not pool2's block, must be ignored
+    my_assert(mem_pool_alloc(pool2, 1) == NULL);
+
+    mem_pool_destroy(pool1); // Releases block1 without freeing it first
+    memset(block2, 0xAB, 1024);
+    block2 = mem_pool_resize(pool2, block2, 512);
+    my_assert(block2 != NULL);
+    my_assert(mem_pool_alloc(pool2, 512) != NULL);
+
+    mem_pool_destroy(pool2);
+
+    // Pools past the limit on thread keys still work, without thread caches,
+    // and destroying one leaves the other pools' caches alone
+    static mem_pool_t *pools[1100];
+    for (int i = 0; i < 1100; i++)
+    {
+        pools[i] = mem_pool_create(1024);
+        my_assert(pools[i] != NULL);
+        mem_pool_free(pools[i], mem_pool_alloc(pools[i], 16));
+        my_assert(mem_pool_alloc(pools[i], 16) != NULL);
+    }
+    for (int i = 1099; i >= 100; i--)
+        mem_pool_destroy(pools[i]);
+    for (int i = 0; i < 100; i++)
+    {
+        my_assert(mem_pool_alloc(pools[i], 16) != NULL);
+        mem_pool_destroy(pools[i]);
+    }
+    printf_green("[PASS].\n");
+}
+
+void test_alignment()
+{
+    printf_yellow("  Testing block alignment ---> ");
+    mem_init(16384);
+
+    // Odd sizes must not push later blocks off the default alignment
+    for (int size = 1; size < 200; size += 37)
+    {
+        void *block = mem_alloc(size);
+        my_assert(block != NULL && (size_t)block % MEM_ALIGN == 0);
+    }
+    mem_deinit();
+
+    // Cache line and page aligned blocks; the padding must stay usable
+    mem_init(16384);
+    void *line = mem_alloc_aligned(100, 64);
+    my_assert(line != NULL && (size_t)line % 64 == 0);
+    mem_free(line);
+
+    void *page = mem_alloc_aligned(4096, 4096);
+    my_assert(page != NULL && (size_t)page % 4096 == 0);
+    int count = 0;
+    while (mem_alloc(16) != NULL)
+        count++;
+    my_assert(count * 16 + 4096 == 16384); // No byte lost to padding
+
+    my_assert(mem_alloc_aligned(16, 3) == NULL); // Not a power of two
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_arena()
+{
+    printf_yellow("  Testing arena mark and reset ---> ");
+    mem_init(4096);
+    void *before = mem_alloc(100);
+    mem_arena_t *arena = mem_arena_create(1024);
+    void *after = mem_alloc(100); // The general allocator keeps working next to the arena
+    my_assert(before != NULL && arena != NULL && after != NULL);
+
+    void *first = mem_arena_alloc(arena, 100);
+    my_assert(first != NULL && (size_t)first % MEM_ALIGN == 0);
+    size_t mark = mem_arena_mark(arena);
+
+    int count = 0;
+    while (mem_arena_alloc(arena, 24) != NULL)
+        count++;
+    my_assert(count > 0);
+
+    // Rewinding to the mark makes the same space available again
+    mem_arena_reset(arena, mark);
+    my_assert(mem_arena_alloc(arena, 24) == (char *)first + 112);
+    mem_arena_reset(arena, 0);
+    my_assert(mem_arena_alloc(arena, 100) == first);
+
+    mem_arena_destroy(arena);
+    mem_free(before);
+    mem_free(after);
+    my_assert(mem_alloc(4096) != NULL); // The arena's block went back to the pool
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_slab()
+{
+    printf_yellow("  Testing fixed-size slab ---> ");
+    mem_init(4096);
+    mem_slab_t *slab = mem_slab_create(16, 8);
+    my_assert(slab != NULL);
+
+    void *objs[8];
+    for (int i = 0; i < 8; i++)
+    {
+        objs[i] = mem_slab_alloc(slab);
+        my_assert(objs[i] != NULL && (size_t)objs[i] % MEM_ALIGN == 0);
+        memset(objs[i], 0xAB, 16);
+    }
+    my_assert(mem_slab_alloc(slab) == NULL); // Every slot is taken
+
+    // A freed slot is the next one handed out; foreign pointers are ignored
+    mem_slab_free(slab, objs[3]);
+    mem_slab_free(slab, (char *)objs[5] + 1);
+    my_assert(mem_slab_alloc(slab) == objs[3]);
+    my_assert(mem_slab_alloc(slab) == NULL);
+
+    mem_slab_destroy(slab);
+    my_assert(mem_alloc(4096) != NULL); // The slab's block went back to the pool
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+#define SHARED_CHILDREN 4
+
+void test_shared_pool()
+{
+    printf_yellow("  Testing pool shared between processes ---> ");
+    mem_pool_t *pool = mem_pool_create_shared(1024 * 1024, 4096);
+    my_assert(pool != NULL);
+
+    // The children report their blocks through a table in the pool itself
+    char **results = mem_pool_alloc(pool, SHARED_CHILDREN * sizeof(char *));
+    my_assert(results != NULL);
+
+    for (int child = 0; child < SHARED_CHILDREN; child++)
+    {
+        pid_t pid = fork();
+        my_assert(pid >= 0);
+        if (pid == 0)
+        {
+            // Churn through blocks, checking that no other process writes into ours
+            unsigned seed = child + 1;
+            char *blocks[64] = {0};
+            size_t sizes[64];
+            for (int op = 0; op < 20000; op++)
+            {
+                int k = rand_r(&seed) % 64;
+                if (blocks[k])
+                {
+                    for (size_t i = 0; i < sizes[k]; i++)
+                        if (blocks[k][i] != (char)child)
+                            _exit(1);
+                    mem_pool_free(pool, blocks[k]);
+                    blocks[k] = NULL;
+                }
+                else
+                {
+                    sizes[k] = 1 + rand_r(&seed) % 200;
+                    blocks[k] = mem_pool_alloc(pool, sizes[k]);
+                    if (!blocks[k])
+                        _exit(2);
+                    memset(blocks[k], child, sizes[k]);
+                }
+            }
+            for (int k = 0; k < 64; k++)
+                mem_pool_free(pool, blocks[k]);
+
+            // Leave one block behind for the parent
+            results[child] = mem_pool_alloc(pool, 100);
+            if (!results[child])
+                _exit(2);
+            snprintf(results[child], 100, "child %d", child);
+            _exit(0);
+        }
+    }
+
+    for (int child = 0; child < SHARED_CHILDREN; child++)
+    {
+        int status;
+        my_assert(wait(&status) > 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+
+    // The parent sees the children's blocks and can free them
+    char expected[100];
+    for (int child = 0; child < SHARED_CHILDREN; child++)
+    {
+        snprintf(expected, sizeof(expected), "child %d", child);
+        my_assert(results[child] != NULL && strcmp(results[child], expected) == 0);
+        mem_pool_free(pool, results[child]);
+    }
+    mem_pool_free(pool, results);
+    void *all = mem_pool_alloc(pool, 1024 * 1024); // Everything merged back
+    my_assert(all != NULL);
+
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+// Number of resident pages in [ptr, ptr + size), both page aligned
+static size_t resident_pages(void *ptr, size_t size)
+{
+    size_t page = sysconf(_SC_PAGESIZE);
+    unsigned char *vec = malloc(size / page);
+    size_t count = 0;
+    my_assert(mincore(ptr, size, vec) == 0);
+    for (size_t i = 0; i < size / page; i++)
+        count += vec[i] & 1;
+    free(vec);
+    return count;
+}
+
+void test_mapped_pool()
+{
+    printf_yellow("  Testing mmap-backed pool ---> ");
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t size = 8 * 1024 * 1024;
+    mem_pool_t *pool = mem_pool_create_mapped(64 * 1024 * 1024, MEM_MAP_RELEASE);
+    my_assert(pool != NULL);
+
+    // Nothing is committed before it is used
+    char *block = mem_pool_alloc(pool, size);
+    my_assert(block != NULL && (size_t)block % page == 0);
+    my_assert(resident_pages(block, size) == 0);
+    memset(block, 0xAB, size);
+    my_assert(resident_pages(block, size) == size / page);
+
+    // Freeing hands the pages back; the memory reads as zeros when used again
+    char *small = mem_pool_alloc(pool, 100);
+    mem_pool_free(pool, block);
+    my_assert(resident_pages(block, size) == 0);
+    char *again = mem_pool_alloc(pool, size);
+    my_assert(again == block && again[0] == 0 && again[size - 1] == 0);
+
+    // Without MEM_MAP_RELEASE the pages stay
+    mem_pool_t *keep = mem_pool_create_mapped(size, MEM_MAP_HUGEPAGES);
+    block = mem_pool_alloc(keep, size);
+    my_assert(block != NULL);
+    memset(block, 0xAB, size);
+    mem_pool_free(keep, block);
+    my_assert(mem_pool_alloc(keep, size) == block && block[size - 1] == (char)0xAB);
+
+    mem_pool_free(pool, small);
+    mem_pool_destroy(keep);
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+void test_growable_pool()
+{
+    printf_yellow("  Testing growable pool ---> ");
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t max = 64 * page;
+    mem_pool_t *pool = mem_pool_create_growable(page, max, 0);
+    my_assert(pool != NULL);
+
+    // Fill well past the first chunk; earlier blocks keep their address and contents
+    char *blocks[60];
+    for (int i = 0; i < 60; i++)
+    {
+        blocks[i] = mem_pool_alloc(pool, page / 2);
+        my_assert(blocks[i] != NULL);
+        memset(blocks[i], i, page / 2);
+    }
+    for (int i = 0; i < 60; i++)
+    {
+        my_assert(blocks[i][0] == i && blocks[i][page / 2 - 1] == i);
+    }
+
+    // Blocks from every chunk can be freed and resized
+    mem_pool_free(pool, blocks[0]);
+    blocks[0] = NULL;
+    blocks[59] = mem_pool_resize(pool, blocks[59], page);
+    my_assert(blocks[59] != NULL && blocks[59][page / 2 - 1] == 59);
+
+    // The pool stops at its cap
+    my_assert(mem_pool_alloc(pool, max) == NULL);
+
+    // With everything freed the chunks merge into one block again
+    for (int i = 0; i < 60; i++)
+    {
+        mem_pool_free(pool, blocks[i]);
+    }
+    char *whole = mem_pool_alloc(pool, max);
+    my_assert(whole != NULL);
+    memset(whole, 0, max);
+    mem_pool_free(pool, whole);
+    mem_pool_destroy(pool);
+
+    // The default pool can grow too
+    mem_init_growable(1024, 1024 * 1024, 0);
+    void *big = mem_alloc(512 * 1024);
+    my_assert(big != NULL);
+    mem_free(big);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+void test_stats()
+{
+    printf_yellow("  Testing allocator statistics ---> ");
+    struct mem_stats st;
+    mem_pool_t *pool = mem_pool_create(4096);
+
+    mem_pool_stats(pool, &st);
+    my_assert(st.pool_size == 4096 && st.live_blocks == 0 && st.used_bytes == 0);
+    my_assert(st.free_bytes == 4096 && st.free_blocks == 1 && st.largest_free == 4096 && st.fragmentation == 0.0);
+
+    // Three blocks carved off the front, one split each
+    char *a = mem_pool_alloc(pool, 256);
+    char *b = mem_pool_alloc(pool, 256);
+    char *c = mem_pool_alloc(pool, 256);
+    mem_pool_stats(pool, &st);
+    my_assert(st.allocs == 3 && st.live_blocks == 3 && st.splits == 3 && st.merges == 0);
+    my_assert(st.used_bytes == 768 && st.free_bytes == 4096 - 768 && st.largest_free == 4096 - 768);
+
+    // A hole in front of c fragments the free space; freeing a merges it into the hole
+    mem_pool_free(pool, b);
+    mem_pool_stats(pool, &st);
+    my_assert(st.frees == 1 && st.free_blocks == 2 && st.fragmentation > 0.0 && st.fragmentation < 0.1);
+    mem_pool_free(pool, a);
+    mem_pool_stats(pool, &st);
+    my_assert(st.merges == 1 && st.free_blocks == 2 && st.free_bytes == 4096 - 256);
+
+    // Growing into the free block behind c stays in place; with d in the way, c has to move
+    c = mem_pool_resize(pool, c, 512);
+    char *d = mem_pool_alloc(pool, 1024);
+    mem_pool_stats(pool, &st);
+    my_assert(st.resizes_in_place == 1 && st.resizes_moved == 0);
+    c = mem_pool_resize(pool, c, 2048);
+    mem_pool_stats(pool, &st);
+    my_assert(c != NULL && st.resizes_moved == 1 && st.live_blocks == 2);
+
+    // Requests that don't fit are counted, small blocks from the thread cache as well
+    my_assert(mem_pool_alloc(pool, 8192) == NULL && mem_pool_resize(pool, d, 8192) == NULL);
+    void *small = mem_pool_alloc(pool, 16);
+    mem_pool_stats(pool, &st);
+    my_assert(st.failed_allocs == 2 && st.allocs == 5 && st.live_blocks == 3);
+    mem_pool_free(pool, small);
+    mem_pool_free(pool, c);
+    mem_pool_free(pool, d);
+    mem_pool_stats(pool, &st);
+    my_assert(st.live_blocks == 0 && st.used_bytes + st.free_bytes == st.pool_size);
+    mem_pool_destroy(pool);
+
+    // The default pool
+    mem_init(1024);
+    void *block = mem_alloc(100);
+    mem_stats(&st);
+    my_assert(st.pool_size == 1024 && st.live_blocks == 1 && st.used_bytes >= 100);
+    mem_free(block);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
+// Hook for test_trace: counts the calls and allocates from inside the hook
+static int hook_calls[MEM_OP_COUNT];
+static void *hook_block;
+
+static void count_hook(mem_pool_t *pool, enum mem_op op, void *old_block, void *new_block, size_t size, void *arg)
+{
+    hook_calls[op]++;
+    hook_block = op == MEM_OP_FREE ? old_block : new_block;
+    *(mem_pool_t **)arg = pool;
+    if (op == MEM_OP_ALLOC)
+        mem_pool_free(pool, mem_pool_alloc(pool, size));
+}
+
+static void *trace_worker(void *arg)
+{
+    for (int i = 0; i < 50; i++)
+    {
+        mem_pool_free(arg, mem_pool_alloc(arg, 200));
+    }
+    return NULL;
+}
+
+void test_trace()
+{
+    printf_yellow("  Testing latency histograms and hooks ---> ");
+    struct mem_latency lat;
+    mem_pool_t *seen = NULL;
+
+    // Without MEM_TRACE there is nothing to record
+    if (!mem_set_hook(count_hook, &seen))
+    {
+        my_assert(mem_latency(MEM_OP_ALLOC, &lat) == 0 && lat.count == 0);
+        printf_green("[PASS] (MEM_TRACE not compiled in).\n");
+        return;
+    }
+    mem_latency_reset();
+    mem_pool_t *pool = mem_pool_create(64 * 1024);
+
+    // The hook sees every operation but not the ones it makes itself
+    void *blocks[100];
+    for (int i = 0; i < 100; i++)
+    {
+        blocks[i] = mem_pool_alloc(pool, 100);
+    }
+    my_assert(hook_calls[MEM_OP_ALLOC] == 100 && hook_block == blocks[99] && seen == pool);
+    blocks[0] = mem_pool_resize(pool, blocks[0], 300);
+    my_assert(hook_calls[MEM_OP_RESIZE] == 1 && hook_block == blocks[0]);
+    for (int i = 0; i < 100; i++)
+    {
+        mem_pool_free(pool, blocks[i]);
+    }
+    my_assert(hook_calls[MEM_OP_FREE] == 100 && hook_block == blocks[99]);
+    mem_set_hook(NULL, NULL);
+
+    // Latencies of a thread that has exited still count
+    pthread_t thread;
+    pthread_create(&thread, NULL, trace_worker, pool);
+    pthread_join(thread, NULL);
+
+    // The hook's own calls are timed as well
+    my_assert(mem_latency(MEM_OP_ALLOC, &lat) == 1 && lat.count == 250);
+    my_assert(lat.p50_ns <= lat.p99_ns && lat.p99_ns <= lat.p999_ns && lat.p999_ns <= lat.max_ns && lat.max_ns > 0);
+    my_assert(mem_latency(MEM_OP_FREE, &lat) == 1 && lat.count == 250);
+    my_assert(mem_latency(MEM_OP_RESIZE, &lat) == 1 && lat.count == 1 && lat.p50_ns == lat.max_ns);
+    mem_latency_reset();
+    my_assert(mem_latency(MEM_OP_ALLOC, &lat) == 1 && lat.count == 0);
+
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+// Worker for test_malloc_calls: churn through malloc, realloc and free
+static void *malloc_worker(void *arg)
+{
+    unsigned seed = (unsigned)(size_t)arg;
+    unsigned char *blocks[32] = {0};
+    size_t sizes[32] = {0};
+
+    for (int round = 0; round < 20000; round++)
+    {
+        int k = rand_r(&seed) % 32;
+        if (blocks[k] && rand_r(&seed) % 2)
+        {
+            for (size_t i = 0; i < sizes[k]; i++)
+                my_assert(blocks[k][i] == (unsigned char)k);
+            free(blocks[k]);
+            blocks[k] = NULL;
+            sizes[k] = 0;
+        }
+        else
+        {
+            size_t size = 1 + rand_r(&seed) % (rand_r(&seed) % 64 ? 1024 : 2 << 20);
+            unsigned char *block = realloc(blocks[k], size);
+            my_assert(block != NULL);
+            for (size_t i = 0; i < (size < sizes[k] ? size : sizes[k]); i++)
+                my_assert(block[i] == (unsigned char)k);
+            memset(block, k, size);
+            blocks[k] = block;
+            sizes[k] = size;
+        }
+    }
+    for (int k = 0; k < 32; k++)
+        free(blocks[k]);
+    return NULL;
+}
+
+// Keeps the pool lock busy until told to stop, for the fork part of test_malloc_calls
+static void *fork_contender(void *arg)
+{
+    volatile int *stop = arg;
+    unsigned seed = 1;
+    while (!*stop)
+    {
+        void *block = malloc(100 + rand_r(&seed) % 4000);
+        my_assert(block != NULL);
+        free(block);
+    }
+    return NULL;
+}
+
+// Runs in the process test_preload starts with LD_PRELOAD=./libmymalloc.so
+void test_malloc_calls()
+{
+    // malloc must come from the preloaded library
+    Dl_info info;
+    my_assert(dladdr((void *)malloc, &info) && strstr(info.dli_fname, "libmymalloc.so"));
+
+    // Every call hands out distinct, usable memory, small and large
+    char *a = malloc(0);
+    char *b = malloc(0);
+    char *big = malloc(4 << 20);
+    my_assert(a != NULL && b != NULL && a != b && big != NULL);
+    my_assert(malloc_usable_size(big) >= (4 << 20));
+    memset(big, 1, 4 << 20);
+
+    // realloc keeps the contents when a block moves from the pool to its own mapping and back
+    char *text = malloc(100);
+    strcpy(text, "kept across realloc");
+    text = realloc(text, 3 << 20);
+    my_assert(text != NULL && strcmp(text, "kept across realloc") == 0);
+    text = realloc(text, 50);
+    my_assert(text != NULL && strcmp(text, "kept across realloc") == 0);
+
+    // calloc clears reused memory
+    char *dirty = malloc(1000);
+    memset(dirty, 0xFF, 1000);
+    free(dirty);
+    unsigned char *clean = calloc(10, 100);
+    for (int i = 0; i < 1000; i++)
+        my_assert(clean[i] == 0);
+    volatile size_t huge = (size_t)-1; // volatile: the compiler would warn about a constant
+    my_assert(calloc(huge, 16) == NULL && errno == ENOMEM);
+
+    // Aligned requests
+    void *aligned;
+    my_assert(posix_memalign(&aligned, 64, 200) == 0 && (size_t)aligned % 64 == 0);
+    free(aligned);
+    my_assert(posix_memalign(&aligned, 3, 200) == EINVAL);
+    aligned = aligned_alloc(4096, 3 << 20);
+    my_assert(aligned != NULL && (size_t)aligned % 4096 == 0);
+    free(aligned);
+
+    // Several threads at once
+    pthread_t threads[4];
+    for (int t = 0; t < 4; t++)
+        pthread_create(&threads[t], NULL, malloc_worker, (void *)(size_t)(t + 1));
+    for (int t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+
+    // Forking while other threads allocate: the child must find the pool lock free.
+    // A child that hangs on it is killed by the alarm.
+    volatile int stop = 0;
+    for (int t = 0; t < 4; t++)
+        pthread_create(&threads[t], NULL, fork_contender, (void *)&stop);
+    for (int i = 0; i < 200; i++)
+    {
+        pid_t pid = fork();
+        my_assert(pid >= 0);
+        if (pid == 0)
+        {
+            alarm(10);
+            void *block = malloc(1000);
+            free(block);
+            _exit(block ? 0 : 1);
+        }
+        int status;
+        my_assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    }
+    stop = 1;
+    for (int t = 0; t < 4; t++)
+        pthread_join(threads[t], NULL);
+
+    free(a);
+    free(b);
+    free(big);
+    free(text);
+    free(clean);
+}
+
+void test_preload()
+{
+    printf_yellow("  Testing malloc and friends from libmymalloc.so ---> ");
+    fflush(stdout);
+    my_assert(access("./libmymalloc.so", R_OK) == 0);
+
+    // Run test 35 in a new process with the library preloaded
+    pid_t pid = fork();
+    my_assert(pid >= 0);
+    if (pid == 0)
+    {
+        setenv("LD_PRELOAD", "./libmymalloc.so", 1);
+        execl("/proc/self/exe", "test_memory_manager", "35", (char *)NULL);
+        _exit(127);
+    }
+    int status;
+    my_assert(waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    printf_green("[PASS].\n");
+}
+
+void test_large_blocks()
+{
+    printf_yellow("  Testing mmap'd large blocks ---> ");
+    struct mem_stats st;
+    size_t mib = 1024 * 1024;
+    mem_pool_t *pool = mem_pool_create(mib);
+
+    // Off by default: a request bigger than the pool fails
+    my_assert(mem_pool_alloc(pool, 4 * mib) == NULL);
+    my_assert(mem_pool_set_mmap_threshold(pool, 256 * 1024));
+
+    // Large requests get a mapping of their own and leave the pool alone
+    char *big = mem_pool_alloc(pool, 4 * mib);
+    my_assert(big != NULL && (size_t)big % MEM_ALIGN == 0 && mem_pool_owns(pool, big));
+    my_assert(mem_pool_block_size(pool, big) >= 4 * mib);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 1 && st.large_bytes >= 4 * mib && st.free_bytes == mib && st.live_blocks == 1);
+    for (size_t i = 0; i < 4 * mib; i += 4096)
+        big[i] = (char)(i / 4096);
+
+    // They grow and shrink with mremap, keeping their contents
+    big = mem_pool_resize(pool, big, 64 * mib);
+    my_assert(big != NULL && mem_pool_block_size(pool, big) >= 64 * mib);
+    memset(big + 4 * mib, 1, 60 * mib);
+    big = mem_pool_resize(pool, big, 2 * mib);
+    for (size_t i = 0; i < 2 * mib; i += 4096)
+        my_assert(big[i] == (char)(i / 4096));
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 1 && st.large_bytes < 4 * mib && st.resizes_in_place + st.resizes_moved == 2);
+
+    // Below the threshold a block moves into the pool, and back out once it grows past it
+    big = mem_pool_resize(pool, big, 1000);
+    my_assert(big != NULL && big[4096 % 1000] == 0 && big[0] == 0);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 0 && st.free_bytes < mib);
+    memset(big, 7, 1000);
+    char *blocker = mem_pool_alloc(pool, 100);
+    big = mem_pool_resize(pool, big, 512 * 1024);
+    my_assert(big != NULL && big[999] == 7 && mem_pool_block_size(pool, big) >= 512 * 1024);
+    mem_pool_free(pool, blocker);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 1 && st.free_bytes == mib);
+
+    // One that grows is remapped even after the threshold was raised or switched off,
+    // whether or not the pool has room for it
+    my_assert(mem_pool_set_mmap_threshold(pool, 8 * mib));
+    big = mem_pool_resize(pool, big, 768 * 1024);
+    my_assert(big != NULL && big[999] == 7 && mem_pool_block_size(pool, big) >= 768 * 1024);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 1 && st.free_bytes == mib);
+    memset(big, 7, 768 * 1024);
+    my_assert(mem_pool_set_mmap_threshold(pool, 0));
+    big = mem_pool_resize(pool, big, 4 * mib);
+    my_assert(big != NULL && big[768 * 1024 - 1] == 7 && mem_pool_block_size(pool, big) >= 4 * mib);
+    memset(big, 7, 4 * mib);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 1 && st.free_bytes == mib);
+    my_assert(mem_pool_set_mmap_threshold(pool, 256 * 1024));
+
+    // Freeing unmaps them; pointers from elsewhere are still ignored
+    char *other = malloc(100);
+    my_assert(!mem_pool_owns(pool, other));
+    mem_pool_free(pool, other);
+    free(other);
+    size_t header = (size_t)big % sysconf(_SC_PAGESIZE);
+    mem_pool_free(pool, big);
+    mem_pool_stats(pool, &st);
+    my_assert(st.large_blocks == 0 && st.large_bytes == 0 && st.live_blocks == 0);
+
+    // Freeing one again, once it is unmapped, is ignored
+    mem_pool_free(pool, big);
+    my_assert(mem_pool_resize(pool, big, 100) == NULL && !mem_pool_owns(pool, big));
+    mem_pool_stats(pool, &st);
+    my_assert(st.frees == st.allocs && st.live_blocks == 0);
+
+    // Destroying the pool unmaps what is left
+    my_assert(mem_pool_alloc(pool, 8 * mib) != NULL);
+    mem_pool_destroy(pool);
+
+    // A pointer into a growable pool's reserved tail that looks like a large block is not read
+    pool = mem_pool_create_growable(mib, 64 * mib, 0);
+    my_assert(mem_pool_set_mmap_threshold(pool, 256 * 1024));
+    char *first = mem_pool_alloc(pool, 100);
+    char *tail = first + 32 * mib - (size_t)first % sysconf(_SC_PAGESIZE) + header;
+    my_assert(!mem_pool_owns(pool, tail));
+    mem_pool_free(pool, tail);
+    my_assert(mem_pool_resize(pool, tail, 100) == NULL);
+    mem_pool_destroy(pool);
+
+    // The default pool, and shared pools that can't do it
+    mem_init(1024);
+    my_assert(mem_set_mmap_threshold(64 * 1024));
+    void *block = mem_alloc(mib);
+    my_assert(block != NULL);
+    mem_free(block);
+    mem_deinit();
+    pool = mem_pool_create_shared(mib, 16);
+    my_assert(!mem_pool_set_mmap_threshold(pool, 64 * 1024));
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+void test_resize_shift()
+{
+    printf_yellow("  Testing resize into the free block in front ---> ");
+    struct mem_stats st;
+    enum mem_resize_how how;
+    mem_pool_t *pool = mem_pool_create(64 * 1024);
+
+    // Free blocks on both sides: the block takes in both and its data moves down
+    char *a = mem_pool_alloc(pool, 1000);
+    char *b = mem_pool_alloc(pool, 1000);
+    char *c = mem_pool_alloc(pool, 1000);
+    char *blocker = mem_pool_alloc(pool, 1000);
+    my_assert(mem_pool_alloc(pool, 1000) != NULL);
+    for (int i = 0; i < 1000; i++)
+        b[i] = (char)i;
+    mem_pool_free(pool, a);
+    mem_pool_free(pool, c);
+    char *shifted = mem_pool_resize_ex(pool, b, 2900, &how);
+    my_assert(shifted == a && how == MEM_RESIZE_SHIFTED);
+    for (int i = 0; i < 1000; i++)
+        my_assert(shifted[i] == (char)i);
+    mem_pool_stats(pool, &st);
+    my_assert(st.resizes_shifted == 1 && st.resizes_moved == 0 && st.live_blocks == 3);
+
+    // What is left of the three blocks stays with it, so a bit more growth is in place
+    my_assert(mem_pool_resize_ex(pool, shifted, 2990, &how) == shifted && how == MEM_RESIZE_IN_PLACE);
+
+    // A block that has to move gets room up to the next size class
+    char *moved = mem_pool_resize_ex(pool, blocker, 5000, &how);
+    my_assert(moved != NULL && moved != blocker && how == MEM_RESIZE_MOVED);
+    my_assert(mem_pool_block_size(pool, moved) == 5120);
+    my_assert(mem_pool_resize_ex(pool, moved, 5100, &how) == moved && how == MEM_RESIZE_IN_PLACE);
+
+    // Failures say so; how may be left out
+    my_assert(mem_pool_resize_ex(pool, moved, 1 << 20, &how) == NULL && how == MEM_RESIZE_FAILED);
+    my_assert(mem_pool_resize_ex(pool, moved, 100, NULL) == moved);
+    mem_pool_destroy(pool);
+
+    // The default pool
+    mem_init(4096);
+    void *block = mem_resize_ex(NULL, 100, &how);
+    my_assert(block != NULL && how == MEM_RESIZE_MOVED);
+    my_assert(mem_resize_ex(block, 0, &how) == NULL && how == MEM_RESIZE_FAILED);
+    mem_deinit();
+    printf_green("[PASS].\n");
+}
+
 
 int main(int argc, char *argv[])
 {
@@ -447,6 +1309,22 @@ int main(int argc, char *argv[])
         printf(" 19. test_init, but large memory - Initialize memory system\n");
 	printf(" 20. test_looking_for_out_of_bounds, needs LD_PRELOAD=./libmymalloc.so .Needs argument of size.\n\n");
 	printf(" 21. test_mmap, needs LD_PRELOAD=./libmymalloc.so .\n\n");
+	printf(" 22. test_free_random_order - Free blocks in random order and check that they merge back.\n");
+	printf(" 23. test_fixed_metadata - Check mem_init_fixed's node limit and that it makes no system allocations.\n");
+	printf(" 24. test_threads - Allocate and free from several threads at once.\n");
+	printf(" 25. test_multiple_pools - Use independent pools side by side, more than there are thread keys.\n");
+	printf(" 26. test_alignment - Check default alignment and mem_alloc_aligned.\n");
+	printf(" 27. test_arena - Bump allocate from an arena and rewind it with mark/reset.\n");
+	printf(" 28. test_slab - Allocate and free fixed-size objects from a slab.\n");
+	printf(" 29. test_shared_pool - Allocate and free from a shared pool in several forked processes.\n");
+	printf(" 30. test_mapped_pool - Check lazy commit and page release of an mmap-backed pool.\n");
+	printf(" 31. test_growable_pool - Check that a pool grows on demand without moving blocks.\n");
+	printf(" 32. test_stats - Check the counters and free space reported by mem_stats.\n");
+	printf(" 33. test_trace - Check latency histograms and hooks (build with make TRACE=1).\n");
+	printf(" 34. test_preload - Run test 35 with LD_PRELOAD=./libmymalloc.so.\n");
+	printf(" 35. test_malloc_calls - Check malloc, calloc, realloc, free and posix_memalign.\n");
+	printf(" 36. test_large_blocks - Check that large blocks get mmap regions of their own.\n");
+	printf(" 37. test_resize_shift - Check that a resize takes in the free block in front.\n");
 	
         printf(" 0. Run all tests (excluding 20)\n");
         return 1;
@@ -485,6 +1363,21 @@ int main(int argc, char *argv[])
         test_zero_alloc_and_free();
         test_random_blocks();
 	test_init(1048576);
+        test_free_random_order();
+        test_fixed_metadata();
+        test_threads();
+        test_multiple_pools();
+        test_alignment();
+        test_arena();
+        test_slab();
+        test_shared_pool();
+        test_mapped_pool();
+        test_growable_pool();
+        test_stats();
+        test_trace();
+        test_preload();
+        test_large_blocks();
+        test_resize_shift();
         break;
     case 1:
         test_init(1024);
@@ -552,6 +1445,54 @@ int main(int argc, char *argv[])
       printf("Test 21.\n");
       test_mmap();
       break;
+    case 22:
+      test_free_random_order();
+      break;
+    case 23:
+      test_fixed_metadata();
+      break;
+    case 24:
+      test_threads();
+      break;
+    case 25:
+      test_multiple_pools();
+      break;
+    case 26:
+      test_alignment();
+      break;
+    case 27:
+      test_arena();
+      break;
+    case 28:
+      test_slab();
+      break;
+    case 29:
+      test_shared_pool();
+      break;
+    case 30:
+      test_mapped_pool();
+      break;
+    case 31:
+      test_growable_pool();
+      break;
+    case 32:
+      test_stats();
+      break;
+    case 33:
+      test_trace();
+      break;
+    case 34:
+      test_preload();
+      break;
+    case 35:
+      test_malloc_calls();
+      break;
+    case 36:
+      test_large_blocks();
+      break;
+    case 37:
+      test_resize_shift();
+      break;
     default:
       printf("Invalid test function\n");
       break;
@@ -0,0 +1,226 @@
+#include "offset_list.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common_defs.h"
+#include "gitdata.h"
+
+// Check that the list holds exactly values[0..count-1], in order
+void check_values(OffsetList *list, const uint16_t *values, size_t count)
+{
+    size_t k = 0;
+    OffsetNode *last = NULL;
+    for (OffsetNode *node = olist_head(list); node; node = olist_next(list, node))
+    {
+        my_assert(k < count && node->data == values[k]);
+        last = node;
+        k++;
+    }
+    my_assert(k == count && olist_count(list) == count);
+    my_assert(count == 0 ? list->tail == 0 : (char *)list + list->tail == (char *)last);
+}
+
+// ********* Test basic offset list operations *********
+
+void test_olist_insert()
+{
+    printf_yellow("  Testing olist_insert ---> ");
+    mem_pool_t *pool = mem_pool_create(olist_size(200) * 2);
+    OffsetList *list = olist_create(pool, olist_size(100));
+    uint16_t values[100];
+    my_assert(list != NULL && sizeof(OffsetNode) == 8);
+
+    for (int i = 0; i < 100; i++)
+    {
+        values[i] = i * 3;
+        olist_insert(list, values[i]);
+    }
+    check_values(list, values, 100);
+
+    olist_destroy(pool, list);
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+void test_olist_insert_after_before()
+{
+    printf_yellow("  Testing olist_insert_after/before ---> ");
+    mem_pool_t *pool = mem_pool_create(olist_size(20) * 2);
+    OffsetList *list = olist_create(pool, olist_size(10));
+
+    olist_insert(list, 2);
+    olist_insert(list, 4);
+    olist_insert_before(list, olist_search(list, 2), 1);
+    olist_insert_before(list, olist_search(list, 4), 3);
+    olist_insert_after(list, olist_search(list, 4), 5);
+    uint16_t values[] = {1, 2, 3, 4, 5};
+    check_values(list, values, 5);
+
+    olist_destroy(pool, list);
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+void test_olist_delete()
+{
+    printf_yellow("  Testing olist_delete ---> ");
+    mem_pool_t *pool = mem_pool_create(olist_size(100) * 2);
+    OffsetList *list = olist_create(pool, olist_size(50));
+    uint16_t values[50];
+
+    for (int i = 0; i < 50; i++)
+    {
+        olist_insert(list, i);
+    }
+
+    // Delete every even value, the head and the tail among them
+    int kept = 0;
+    for (int i = 0; i < 50; i++)
+    {
+        if (i % 2 == 0)
+            olist_delete(list, i);
+        else
+            values[kept++] = i;
+    }
+    olist_delete(list, 49);
+    kept--;
+    check_values(list, values, kept);
+
+    // Freed nodes are used again
+    for (int i = 0; i < 26; i++)
+    {
+        olist_insert(list, 1000 + i);
+    }
+    my_assert(olist_count(list) == 50 && olist_search(list, 1025) != NULL);
+
+    olist_destroy(pool, list);
+    mem_pool_destroy(pool);
+    printf_green("[PASS].\n");
+}
+
+void test_olist_search()
+{
+    printf_yellow("  Testing olist_search ---> ");
+    uint64_t memory[olist_size(100) / sizeof(uint64_t)];
+    OffsetList *list = olist_init(memory, sizeof(memory));
+
+    for (int i = 0; i < 100; i++)
+    {
+        olist_insert(list, i);
+    }
+    OffsetNode *found = olist_search(list, 60);
+    my_assert(found != NULL && found->data == 60 && olist_next(list, found)->data == 61);
+    my_assert(olist_search(list, 100) == NULL);
+    printf_green("[PASS].\n");
+}
+
+void test_olist_bounds()
+{
+    printf_yellow("  Testing olist block bounds ---> ");
+    uint64_t memory[olist_size(11) / sizeof(uint64_t)];
+
+    // A block holds as many nodes as fit behind the descriptor, and no more
+    my_assert(olist_init(memory, sizeof(OffsetList) - 1) == NULL);
+    OffsetList *list = olist_init(memory, olist_size(10) + sizeof(OffsetNode) - 1);
+    for (int i = 0; i <= 10; i++)
+    {
+        olist_insert(list, i);
+    }
+    my_assert(olist_count(list) == 10 && list->size == olist_size(10));
+    printf_green("[PASS].\n");
+}
+
+void test_olist_relocate()
+{
+    printf_yellow("  Testing moving an offset list ---> ");
+    size_t size = olist_size(1000);
+    char *memory = malloc(size);
+    OffsetList *list = olist_init(memory, size);
+    uint16_t values[1000];
+
+    for (int i = 0; i < 500; i++)
+    {
+        values[i] = i;
+        olist_insert(list, i);
+    }
+
+    // Copy the block elsewhere and wipe the original; the copy is a complete list
+    char *moved = malloc(size);
+    memcpy(moved, memory, size);
+    memset(memory, 0xFF, size);
+    free(memory);
+    OffsetList *copy = (OffsetList *)moved;
+    check_values(copy, values, 500);
+
+    // It can be changed at its new address too
+    for (int i = 500; i < 1000; i++)
+    {
+        values[i] = i;
+        olist_insert(copy, i);
+    }
+    check_values(copy, values, 1000);
+    olist_delete(copy, 999);
+    check_values(copy, values, 999);
+
+    free(moved);
+    printf_green("[PASS].\n");
+}
+
+// Main function to run all tests
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+#ifdef VERSION
+    printf("Build Version; %s \n", VERSION);
+#endif
+    printf("Git Version; %s/%s \n", git_date, git_sha);
+    if (argc < 2)
+    {
+        printf("Usage: %s <test function>\n", argv[0]);
+        printf("Available test functions:\n");
+        printf(" 1. test_olist_insert - Test appending values\n");
+        printf(" 2. test_olist_insert_after_before - Test inserting next to a node\n");
+        printf(" 3. test_olist_delete - Test delete operation\n");
+        printf(" 4. test_olist_search - Test search for a particular value\n");
+        printf(" 5. test_olist_bounds - Test that the block size limits the nodes\n");
+        printf(" 6. test_olist_relocate - Test that a copied list works at its new address\n");
+        printf(" 0. Run all tests\n");
+        return 1;
+    }
+
+    switch (atoi(argv[1]))
+    {
+    case 0:
+        test_olist_insert();
+        test_olist_insert_after_before();
+        test_olist_delete();
+        test_olist_search();
+        test_olist_bounds();
+        test_olist_relocate();
+        break;
+    case 1:
+        test_olist_insert();
+        break;
+    case 2:
+        test_olist_insert_after_before();
+        break;
+    case 3:
+        test_olist_delete();
+        break;
+    case 4:
+        test_olist_search();
+        break;
+    case 5:
+        test_olist_bounds();
+        break;
+    case 6:
+        test_olist_relocate();
+        break;
+    default:
+        printf("Invalid test function\n");
+        break;
+    }
+
+    return 0;
+}
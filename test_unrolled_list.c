@@ -0,0 +1,299 @@
+#include "unrolled_list.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "common_defs.h"
+#include "gitdata.h"
+
+// Run ulist_display_range with stdout redirected into buffer
+void capture_display_range(char *buffer, size_t size, UnrolledList *list, UnrolledPos start, UnrolledPos end)
+{
+    FILE *original_stdout = stdout;
+    FILE *fp = tmpfile();
+    if (fp == NULL)
+    {
+        printf("Failed to open temporary file for capturing stdout.\n");
+        return;
+    }
+
+    stdout = fp;
+    ulist_display_range(list, start, end);
+    fflush(fp);
+    rewind(fp);
+
+    size_t got = fread(buffer, 1, size - 1, fp);
+    buffer[got] = '\0';
+
+    fclose(fp);
+    stdout = original_stdout;
+}
+
+// Check that the list holds exactly values[0..count-1], in order
+void check_values(UnrolledList *list, const uint16_t *values, size_t count)
+{
+    size_t k = 0;
+    for (UnrolledChunk *chunk = list->head; chunk; chunk = chunk->next)
+    {
+        my_assert(chunk->count > 0);
+        for (int i = 0; i < chunk->count; i++)
+        {
+            my_assert(k < count && chunk->values[i] == values[k]);
+            k++;
+        }
+        if (!chunk->next)
+            my_assert(list->tail == chunk);
+    }
+    my_assert(k == count && ulist_count(list) == count);
+}
+
+// ********* Test basic unrolled list operations *********
+
+void test_ulist_insert()
+{
+    printf_yellow("  Testing ulist_insert ---> ");
+    UnrolledList list;
+    uint16_t values[100];
+    ulist_init(&list, sizeof(UnrolledChunk) * 4);
+
+    for (int i = 0; i < 100; i++)
+    {
+        values[i] = i * 3;
+        ulist_insert(&list, values[i]);
+    }
+    check_values(&list, values, 100);
+    my_assert(list.head->count == UNROLLED_CHUNK_VALUES); // Appending fills whole chunks
+
+    ulist_cleanup(&list);
+    my_assert(list.head == NULL && ulist_count(&list) == 0);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_insert_after_before()
+{
+    printf_yellow("  Testing ulist_insert_after/before ---> ");
+    UnrolledList list;
+    uint16_t values[UNROLLED_CHUNK_VALUES + 2];
+    ulist_init(&list, sizeof(UnrolledChunk) * 2);
+
+    for (int i = 0; i < UNROLLED_CHUNK_VALUES; i++)
+    {
+        ulist_insert(&list, i + 1);
+    }
+
+    // Inserting into the full chunk splits it in two
+    ulist_insert_before(&list, ulist_search(&list, 1), 0);
+    ulist_insert_after(&list, ulist_search(&list, UNROLLED_CHUNK_VALUES), 1000);
+    for (int i = 0; i <= UNROLLED_CHUNK_VALUES; i++)
+    {
+        values[i] = i;
+    }
+    values[UNROLLED_CHUNK_VALUES + 1] = 1000;
+    check_values(&list, values, UNROLLED_CHUNK_VALUES + 2);
+    my_assert(list.head->next != NULL);
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_delete()
+{
+    printf_yellow("  Testing ulist_delete ---> ");
+    UnrolledList list;
+    uint16_t values[60];
+    ulist_init(&list, sizeof(UnrolledChunk) * 3);
+
+    for (int i = 0; i < 60; i++)
+    {
+        ulist_insert(&list, i);
+    }
+
+    // Delete every even value; half-empty chunks get folded together
+    int kept = 0;
+    for (int i = 0; i < 60; i++)
+    {
+        if (i % 2 == 0)
+            ulist_delete(&list, i);
+        else
+            values[kept++] = i;
+    }
+    check_values(&list, values, kept);
+
+    // Emptying the list drops every chunk
+    for (int i = 0; i < kept; i++)
+    {
+        ulist_delete(&list, values[i]);
+    }
+    my_assert(list.head == NULL && list.tail == NULL && ulist_count(&list) == 0);
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_search()
+{
+    printf_yellow("  Testing ulist_search ---> ");
+    UnrolledList list;
+    ulist_init(&list, sizeof(UnrolledChunk) * 4);
+    for (int i = 0; i < 100; i++)
+    {
+        ulist_insert(&list, i);
+    }
+
+    UnrolledPos found = ulist_search(&list, 60);
+    my_assert(found.chunk != NULL && found.chunk->values[found.index] == 60);
+    my_assert(ulist_search(&list, 100).chunk == NULL);
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_display_range()
+{
+    printf_yellow("  Testing ulist_display_range ---> ");
+    UnrolledList list;
+    char buffer[1024];
+    ulist_init(&list, sizeof(UnrolledChunk) * 2);
+
+    capture_display_range(buffer, sizeof(buffer), &list, (UnrolledPos){NULL, 0}, (UnrolledPos){NULL, 0});
+    my_assert(strcmp(buffer, "[]") == 0);
+
+    for (int i = 10; i < 40; i++)
+    {
+        ulist_insert(&list, i);
+    }
+    capture_display_range(buffer, sizeof(buffer), &list, ulist_search(&list, 35), (UnrolledPos){NULL, 0});
+    my_assert(strcmp(buffer, "[35, 36, 37, 38, 39]") == 0);
+
+    // The range may cross a chunk boundary
+    capture_display_range(buffer, sizeof(buffer), &list, ulist_search(&list, 35), ulist_search(&list, 37));
+    my_assert(strcmp(buffer, "[35, 36, 37]") == 0);
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_pool()
+{
+    printf_yellow("  Testing ulist pool bounds ---> ");
+    UnrolledList list;
+    ulist_init(&list, sizeof(UnrolledChunk));
+
+    // A single chunk fits, so the list holds exactly one chunk worth of values
+    for (int i = 0; i <= UNROLLED_CHUNK_VALUES; i++)
+    {
+        ulist_insert(&list, i);
+    }
+    my_assert(ulist_count(&list) == UNROLLED_CHUNK_VALUES);
+    my_assert((size_t)list.head % sizeof(UnrolledChunk) == 0); // One cache line per chunk
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+void test_ulist_search_modes()
+{
+    printf_yellow("  Testing ulist search modes ---> ");
+    UnrolledList list;
+    ulist_init(&list, sizeof(UnrolledChunk) * 200);
+
+    // Lots of duplicates, and chunks filled to different levels by splits and deletes
+    for (int i = 0; i < 2000; i++)
+    {
+        ulist_insert(&list, rand() % 50);
+    }
+    for (int i = 0; i < 500; i++)
+    {
+        ulist_insert_after(&list, ulist_search(&list, rand() % 50), rand() % 60);
+        ulist_delete(&list, rand() % 50);
+    }
+
+    // Every mode the CPU has must agree with the scalar loop
+    UnrolledPos expected_pos[60];
+    size_t expected_count[60];
+    ulist_set_search_mode(ULIST_SEARCH_SCALAR);
+    for (int value = 0; value < 60; value++)
+    {
+        expected_pos[value] = ulist_search(&list, value);
+        expected_count[value] = ulist_count_matches(&list, value);
+    }
+
+    UnrolledSearchMode modes[] = {ULIST_SEARCH_SSE2, ULIST_SEARCH_AVX2, ULIST_SEARCH_AUTO};
+    for (int m = 0; m < 3; m++)
+    {
+        if (!ulist_set_search_mode(modes[m]))
+            continue;
+        for (int value = 0; value < 60; value++)
+        {
+            UnrolledPos pos = ulist_search(&list, value);
+            my_assert(pos.chunk == expected_pos[value].chunk && pos.index == expected_pos[value].index);
+            my_assert(ulist_count_matches(&list, value) == expected_count[value]);
+        }
+    }
+
+    ulist_cleanup(&list);
+    printf_green("[PASS].\n");
+}
+
+// Main function to run all tests
+int main(int argc, char *argv[])
+{
+    srand(time(NULL));
+#ifdef VERSION
+    printf("Build Version; %s \n", VERSION);
+#endif
+    printf("Git Version; %s/%s \n", git_date, git_sha);
+    if (argc < 2)
+    {
+        printf("Usage: %s <test function>\n", argv[0]);
+        printf("Available test functions:\n");
+        printf(" 1. test_ulist_insert - Test appending values\n");
+        printf(" 2. test_ulist_insert_after_before - Test inserting next to a position\n");
+        printf(" 3. test_ulist_delete - Test delete operation\n");
+        printf(" 4. test_ulist_search - Test search for a particular value\n");
+        printf(" 5. test_ulist_display_range - Test displaying a range\n");
+        printf(" 6. test_ulist_pool - Test that chunks come from a pool sized by ulist_init\n");
+        printf(" 7. test_ulist_search_modes - Test that SIMD and scalar search agree\n");
+        printf(" 0. Run all tests\n");
+        return 1;
+    }
+
+    switch (atoi(argv[1]))
+    {
+    case 0:
+        test_ulist_insert();
+        test_ulist_insert_after_before();
+        test_ulist_delete();
+        test_ulist_search();
+        test_ulist_display_range();
+        test_ulist_pool();
+        test_ulist_search_modes();
+        break;
+    case 1:
+        test_ulist_insert();
+        break;
+    case 2:
+        test_ulist_insert_after_before();
+        break;
+    case 3:
+        test_ulist_delete();
+        break;
+    case 4:
+        test_ulist_search();
+        break;
+    case 5:
+        test_ulist_display_range();
+        break;
+    case 6:
+        test_ulist_pool();
+        break;
+    case 7:
+        test_ulist_search_modes();
+        break;
+    default:
+        printf("Invalid test function\n");
+        break;
+    }
+
+    return 0;
+}
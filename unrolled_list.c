@@ -0,0 +1,332 @@
+#include "unrolled_list.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define ULIST_X86 1
+#endif
+
+_Static_assert(sizeof(UnrolledChunk) == 64, "UnrolledChunk must fill exactly one cache line");
+
+// Bit i is set for every value i of a chunk that equals data
+typedef uint32_t (*chunk_match_fn)(const UnrolledChunk* chunk, uint16_t data);
+
+// Compare a chunk's values one at a time
+static uint32_t chunk_match_scalar(const UnrolledChunk* chunk, uint16_t data) {
+    uint32_t mask = 0;
+    for (int i = 0; i < chunk->count; i++) {
+        if (chunk->values[i] == data) mask |= 1u << i;
+    }
+    return mask;
+}
+
+#ifdef ULIST_X86
+// Compare a chunk's values 8 at a time. The loads cover values 0-15, 16-23 and 19-26;
+// they stay inside the chunk, and lanes past count are masked off at the end.
+__attribute__((target("sse2")))
+static uint32_t chunk_match_sse2(const UnrolledChunk* chunk, uint16_t data) {
+    __m128i key = _mm_set1_epi16((short)data);
+    const __m128i* values = (const __m128i*)chunk->values;
+    __m128i a = _mm_cmpeq_epi16(_mm_loadu_si128(values), key);
+    __m128i b = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(chunk->values + 8)), key);
+    __m128i c = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(chunk->values + 16)), key);
+    __m128i d = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*)(chunk->values + 19)), key);
+
+    uint32_t low = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(a, b));
+    uint32_t high = (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(c, d));
+    uint32_t mask = low | (high & 0xFF) << 16 | (high >> 8) << 19;
+    return mask & ((1u << chunk->count) - 1);
+}
+
+// Compare a chunk's values 16 at a time, with loads covering values 0-15 and 11-26
+__attribute__((target("avx2")))
+static uint32_t chunk_match_avx2(const UnrolledChunk* chunk, uint16_t data) {
+    __m256i key = _mm256_set1_epi16((short)data);
+    __m256i a = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)chunk->values), key);
+    __m256i b = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i*)(chunk->values + 11)), key);
+
+    // Packing interleaves the 128-bit halves; put them back in order before taking the mask
+    __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi16(a, b), 0xD8);
+    uint32_t bits = (uint32_t)_mm256_movemask_epi8(packed);
+    uint32_t mask = (bits & 0xFFFF) | (bits >> 16) << 11;
+    return mask & ((1u << chunk->count) - 1);
+}
+#endif
+
+// The compare routine in use; picked on first use
+static chunk_match_fn chunk_match = NULL;
+
+// Select how chunks are compared (0 if the CPU can't do the requested mode)
+int ulist_set_search_mode(UnrolledSearchMode mode) {
+    chunk_match_fn match = chunk_match_scalar;
+#ifdef ULIST_X86
+    __builtin_cpu_init();
+    int sse2 = __builtin_cpu_supports("sse2");
+    int avx2 = __builtin_cpu_supports("avx2");
+
+    if (mode == ULIST_SEARCH_AUTO) {
+        match = avx2 ? chunk_match_avx2 : sse2 ? chunk_match_sse2 : chunk_match_scalar;
+    } else if (mode == ULIST_SEARCH_SSE2) {
+        if (!sse2) return 0;
+        match = chunk_match_sse2;
+    } else if (mode == ULIST_SEARCH_AVX2) {
+        if (!avx2) return 0;
+        match = chunk_match_avx2;
+    }
+#else
+    if (mode == ULIST_SEARCH_SSE2 || mode == ULIST_SEARCH_AVX2) return 0;
+#endif
+    chunk_match = match;
+    return 1;
+}
+
+// Matches of data in a chunk, using the selected compare routine
+static uint32_t chunk_find(const UnrolledChunk* chunk, uint16_t data) {
+    if (!chunk_match) ulist_set_search_mode(ULIST_SEARCH_AUTO);
+    return chunk_match(chunk, data);
+}
+
+// Take a chunk from the list's pool (NULL if it is used up)
+static UnrolledChunk* chunk_alloc(UnrolledList* list) {
+    UnrolledChunk* chunk = list->free_chunks;
+    if (!chunk) return NULL;
+
+    list->free_chunks = chunk->next;
+    chunk->next = NULL;
+    chunk->count = 0;
+    return chunk;
+}
+
+// Give a chunk back to the list's pool
+static void chunk_release(UnrolledList* list, UnrolledChunk* chunk) {
+    chunk->next = list->free_chunks;
+    list->free_chunks = chunk;
+}
+
+// Put data at index of a chunk, splitting the chunk in two first if it is full
+static int chunk_insert(UnrolledList* list, UnrolledChunk* chunk, int index, uint16_t data) {
+    // Step 1: A full chunk hands its upper half to a new chunk behind it
+    if (chunk->count == UNROLLED_CHUNK_VALUES) {
+        UnrolledChunk* half = chunk_alloc(list);
+        if (!half) return 0;
+
+        int keep = UNROLLED_CHUNK_VALUES / 2;
+        half->count = chunk->count - keep;
+        memcpy(half->values, chunk->values + keep, half->count * sizeof(uint16_t));
+        chunk->count = keep;
+        half->next = chunk->next;
+        chunk->next = half;
+        if (list->tail == chunk) list->tail = half;
+
+        if (index > keep) {
+            chunk = half;
+            index -= keep;
+        }
+    }
+
+    // Step 2: Shift the values behind index up by one and store data
+    memmove(chunk->values + index + 1, chunk->values + index, (chunk->count - index) * sizeof(uint16_t));
+    chunk->values[index] = data;
+    chunk->count++;
+    list->count++;
+    return 1;
+}
+
+// Initialize the list with room for size bytes worth of chunks
+void ulist_init(UnrolledList* list, size_t size) {
+    // Step 1: Start out empty
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+    list->free_chunks = NULL;
+
+    // Step 2: Give the list a pool of its own; one spare chunk size pays for the cache line alignment
+    size_t chunks = size / sizeof(UnrolledChunk);
+    list->pool = mem_pool_create_fixed((chunks + 1) * sizeof(UnrolledChunk), 3);
+    if (!list->pool) {
+        fprintf(stderr, "Error: Memory allocation failed in ulist_init.\n");
+        return;
+    }
+
+    // Step 3: Put all chunks on the free list, lowest address first
+    UnrolledChunk* array = chunks ? mem_pool_alloc_aligned(list->pool, chunks * sizeof(UnrolledChunk), sizeof(UnrolledChunk)) : NULL;
+    for (size_t i = array ? chunks : 0; i > 0; i--) {
+        chunk_release(list, &array[i - 1]);
+    }
+}
+
+// Insert a value at the end of the list
+void ulist_insert(UnrolledList* list, uint16_t data) {
+    // Step 1: Fill up the last chunk first
+    if (list->tail && list->tail->count < UNROLLED_CHUNK_VALUES) {
+        list->tail->values[list->tail->count++] = data;
+        list->count++;
+        return;
+    }
+
+    // Step 2: Otherwise start a new chunk behind it
+    UnrolledChunk* chunk = chunk_alloc(list);
+    if (!chunk) {
+        fprintf(stderr, "Error: Memory allocation failed in ulist_insert.\n");
+        return;
+    }
+    chunk->values[0] = data;
+    chunk->count = 1;
+    if (list->tail) {
+        list->tail->next = chunk;
+    } else {
+        list->head = chunk;
+    }
+    list->tail = chunk;
+    list->count++;
+}
+
+// Insert a value after a specific position
+void ulist_insert_after(UnrolledList* list, UnrolledPos pos, uint16_t data) {
+    // Step 1: Check if the position exists
+    if (!pos.chunk) {
+        fprintf(stderr, "Error: pos is empty in ulist_insert_after.\n");
+        return;
+    }
+
+    // Step 2: Put the value right behind it
+    if (!chunk_insert(list, pos.chunk, pos.index + 1, data)) {
+        fprintf(stderr, "Error: Memory allocation failed in ulist_insert_after.\n");
+    }
+}
+
+// Insert a value before a specific position
+void ulist_insert_before(UnrolledList* list, UnrolledPos pos, uint16_t data) {
+    // Step 1: Check if the position exists
+    if (!pos.chunk) {
+        fprintf(stderr, "Error: pos is empty in ulist_insert_before.\n");
+        return;
+    }
+
+    // Step 2: Put the value in its place, which moves it one up
+    if (!chunk_insert(list, pos.chunk, pos.index, data)) {
+        fprintf(stderr, "Error: Memory allocation failed in ulist_insert_before.\n");
+    }
+}
+
+// Delete the first value equal to data
+void ulist_delete(UnrolledList* list, uint16_t data) {
+    // Step 1: Find the chunk holding the value, keeping track of the one before it
+    UnrolledChunk* prev = NULL;
+    UnrolledChunk* chunk = list->head;
+    uint32_t matches = 0;
+    while (chunk && !(matches = chunk_find(chunk, data))) {
+        prev = chunk;
+        chunk = chunk->next;
+    }
+
+    // Step 2: If not found, print error
+    if (!chunk) {
+        fprintf(stderr, "Error: Data %u not found in ulist_delete.\n", data);
+        return;
+    }
+
+    // Step 3: Close the gap
+    int index = __builtin_ctz(matches);
+    chunk->count--;
+    memmove(chunk->values + index, chunk->values + index + 1, (chunk->count - index) * sizeof(uint16_t));
+    list->count--;
+
+    // Step 4: Drop a chunk that became empty
+    UnrolledChunk* next = chunk->next;
+    if (chunk->count == 0) {
+        if (prev) prev->next = next;
+        else list->head = next;
+        if (list->tail == chunk) list->tail = prev;
+        chunk_release(list, chunk);
+        return;
+    }
+
+    // Step 5: Fold the next chunk into this one if both fit in a single chunk
+    if (next && chunk->count + next->count <= UNROLLED_CHUNK_VALUES) {
+        memcpy(chunk->values + chunk->count, next->values, next->count * sizeof(uint16_t));
+        chunk->count += next->count;
+        chunk->next = next->next;
+        if (list->tail == next) list->tail = chunk;
+        chunk_release(list, next);
+    }
+}
+
+// Search for the first value equal to data
+UnrolledPos ulist_search(UnrolledList* list, uint16_t data) {
+    // Step 1: Compare all values of each chunk in turn
+    for (UnrolledChunk* chunk = list->head; chunk; chunk = chunk->next) {
+        uint32_t matches = chunk_find(chunk, data);
+
+        // Step 2: If value found, return the position of the first match
+        if (matches) {
+            return (UnrolledPos){chunk, __builtin_ctz(matches)};
+        }
+    }
+    // Step 3: Value not found
+    return (UnrolledPos){NULL, 0};
+}
+
+// Count how many values equal data
+size_t ulist_count_matches(UnrolledList* list, uint16_t data) {
+    size_t count = 0;
+    for (UnrolledChunk* chunk = list->head; chunk; chunk = chunk->next) {
+        count += __builtin_popcount(chunk_find(chunk, data));
+    }
+    return count;
+}
+
+// Display the whole list
+void ulist_display(UnrolledList* list) {
+    ulist_display_range(list, (UnrolledPos){NULL, 0}, (UnrolledPos){NULL, 0});
+}
+
+// Display a part of the list (range), from start up to and including end
+void ulist_display_range(UnrolledList* list, UnrolledPos start, UnrolledPos end) {
+    // Step 1: If no start is given, start from the beginning
+    if (!start.chunk) {
+        start.chunk = list->head;
+        start.index = 0;
+    }
+
+    // Step 2: Print each value from start to end
+    printf("[");
+    int first = 1;
+    for (UnrolledChunk* chunk = start.chunk; chunk; chunk = chunk->next) {
+        for (int i = chunk == start.chunk ? start.index : 0; i < chunk->count; i++) {
+            if (!first) {
+                printf(", ");
+            }
+            printf("%u", chunk->values[i]);
+            first = 0;
+
+            if (chunk == end.chunk && i == end.index) {
+                printf("]");
+                return;
+            }
+        }
+    }
+
+    // Step 3: Close the output
+    printf("]");
+}
+
+// Count how many values are in the list
+size_t ulist_count(UnrolledList* list) {
+    return list->count;
+}
+
+// Free all memory and clear the list
+void ulist_cleanup(UnrolledList* list) {
+    // Step 1: Release the list's pool, which frees every chunk in one go
+    mem_pool_destroy(list->pool);
+
+    // Step 2: Reset to an empty list
+    list->pool = NULL;
+    list->head = NULL;
+    list->tail = NULL;
+    list->count = 0;
+    list->free_chunks = NULL;
+}
@@ -0,0 +1,58 @@
+#ifndef UNROLLED_LIST_H
+#define UNROLLED_LIST_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "memory_manager.h"
+
+// Values per chunk: a chunk fills one 64-byte cache line with the next
+// pointer, the number of values in use and the values themselves
+#define UNROLLED_CHUNK_VALUES 27
+
+// Chunk structure definition
+typedef struct UnrolledChunk {
+    struct UnrolledChunk* next;
+    uint16_t count;
+    uint16_t values[UNROLLED_CHUNK_VALUES];
+} UnrolledChunk;
+
+// Position of one value: its chunk (NULL for none) and its index in the chunk.
+// Inserts and deletes move values around, so a position is only good until the next change.
+typedef struct UnrolledPos {
+    UnrolledChunk* chunk;
+    int index;
+} UnrolledPos;
+
+// Unrolled list; its chunks come from a pool of its own set up by ulist_init
+typedef struct UnrolledList {
+    UnrolledChunk* head;
+    UnrolledChunk* tail;
+    size_t count;                // Number of values
+    mem_pool_t* pool;            // Pool holding the chunks
+    UnrolledChunk* free_chunks;  // Unused chunks, linked through next
+} UnrolledList;
+
+// How ulist_search and ulist_count_matches compare values; every mode gives the same results
+typedef enum UnrolledSearchMode {
+    ULIST_SEARCH_AUTO,          // Fastest mode the CPU supports
+    ULIST_SEARCH_SCALAR,        // One value at a time
+    ULIST_SEARCH_SSE2,          // 8 values per compare
+    ULIST_SEARCH_AVX2           // 16 values per compare
+} UnrolledSearchMode;
+
+// Function prototypes
+void ulist_init(UnrolledList* list, size_t size);
+void ulist_insert(UnrolledList* list, uint16_t data);
+void ulist_insert_after(UnrolledList* list, UnrolledPos pos, uint16_t data);
+void ulist_insert_before(UnrolledList* list, UnrolledPos pos, uint16_t data);
+void ulist_delete(UnrolledList* list, uint16_t data);
+UnrolledPos ulist_search(UnrolledList* list, uint16_t data);
+void ulist_display(UnrolledList* list);
+void ulist_display_range(UnrolledList* list, UnrolledPos start, UnrolledPos end);
+size_t ulist_count(UnrolledList* list);
+size_t ulist_count_matches(UnrolledList* list, uint16_t data);
+int ulist_set_search_mode(UnrolledSearchMode mode);
+void ulist_cleanup(UnrolledList* list);
+
+#endif // UNROLLED_LIST_H